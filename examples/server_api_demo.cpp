@@ -41,8 +41,10 @@ void demonstrateServerAPI() {
         header.bodyLength = message.size();
         header.totalLength = sizeof(MessageHeader) + message.size();
 
-        server.broadcast(header, message.c_str());
-        std::cout << "广播消息已发送" << std::endl;
+        BroadcastResult result = server.broadcast(header, message.c_str());
+        std::cout << "广播消息已发送: 成功 " << result.queued
+                  << ", 丢弃 " << result.dropped
+                  << ", 慢客户端 " << result.slow << std::endl;
     }
 
     std::this_thread::sleep_for(std::chrono::seconds(2));
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace tcp_server {
+
+// Local-only scrape endpoint on a Unix domain socket. Every client that
+// connects receives the text produced by the callback, then the server
+// closes the connection, e.g. `nc -U $XDG_RUNTIME_DIR/tcp_server_8888.sock`.
+class AdminServer {
+public:
+    using ContentCallback = std::function<std::string()>;
+
+    AdminServer(const std::string& path, ContentCallback callback);
+    ~AdminServer();
+
+    // tcp_server_<port>.sock in $XDG_RUNTIME_DIR, or in a private 0700
+    // /tmp/tcp_server-<uid> directory when that is unset. Empty if the
+    // directory cannot be created or is not owned by this user.
+    static std::string defaultPath(int port);
+
+    // Bind the socket (owner-only permissions) and start serving
+    bool start();
+
+    // Stop serving and remove the socket file
+    void stop();
+
+    const std::string& getPath() const { return path_; }
+
+private:
+    void serveLoop();
+
+    std::string path_;
+    ContentCallback callback_;
+    int listenFd_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+using AdminServerPtr = std::shared_ptr<AdminServer>;
+
+} // namespace tcp_server
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tcp_server {
+
+// What happens to a sheddable message while the server is overloaded
+enum class AdmissionAction {
+    ADMIT,   // queue it as usual
+    REJECT,  // drop it and count it under shed.<type>
+    DEFER    // queue it, but pause reading its session until the overload ends
+};
+
+// The server counts as overloaded while the p99 of queue_wait_ns over the
+// last window exceeds queueWaitP99LimitNs, and stops once it falls to
+// half the limit. A limit of 0 disables admission control.
+struct AdmissionConfig {
+    int64_t queueWaitP99LimitNs = 100 * 1000 * 1000;
+    int64_t windowNs = 100 * 1000 * 1000;
+    AdmissionAction overloadAction = AdmissionAction::DEFER;
+};
+
+// Decides whether sheddable messages are admitted, from how long tasks
+// recently waited in the thread pool queues
+class AdmissionController {
+public:
+    // Called once when an overload ends, on the thread that noticed it
+    using OverloadEndedCallback = std::function<void()>;
+
+    explicit AdmissionController(const Histogram* queueWait);
+    ~AdmissionController() = default;
+
+    // Call before the server starts
+    void setConfig(const AdmissionConfig& config) { config_ = config; }
+    const AdmissionConfig& getConfig() const { return config_; }
+    void setOverloadEndedCallback(OverloadEndedCallback cb) { overloadEndedCb_ = cb; }
+
+    // Action for a sheddable message arriving now, as of the last refresh
+    AdmissionAction admit() const;
+
+    // Recompute the windowed p99 if the window has elapsed, on any thread
+    void refresh(int64_t nowNs);
+
+    // Nothing is waiting in the inbound queue any more, end an overload
+    // without waiting for a window free of the slow tail
+    void onQueueDrained(int64_t nowNs);
+
+    // Sequentially consistent, so a caller that deferred a session and
+    // then sees no overload knows the overload-ended callback may have
+    // missed it
+    bool isOverloaded() const { return overloaded_.load(); }
+
+    // p99 of the last complete window, ns
+    uint64_t getQueueWaitP99() const { return windowP99_.load(std::memory_order_relaxed); }
+
+private:
+    // Start a new window at the current bucket counts, returns the p99
+    // of the window that ended. Caller holds refreshMutex_.
+    uint64_t rollWindow(int64_t nowNs);
+    // Clear overloaded_ and run the callback, releasing lock first
+    void endOverload(std::unique_lock<std::mutex>& lock, uint64_t p99);
+
+    const Histogram* queueWait_;
+    AdmissionConfig config_;
+    OverloadEndedCallback overloadEndedCb_;
+
+    std::atomic<int64_t> nextRefreshNs_;
+    std::atomic<bool> overloaded_;
+    std::atomic<uint64_t> windowP99_;
+
+    // Bucket counts at the start of the current window
+    std::mutex refreshMutex_;
+    std::vector<uint64_t> lastBuckets_;
+    std::vector<uint64_t> buckets_;
+};
+
+using AdmissionControllerPtr = std::shared_ptr<AdmissionController>;
+
+} // namespace tcp_server
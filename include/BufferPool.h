@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tcp_server {
+
+class BufferPool;
+
+// Reference counted block of raw bytes, handed out by BufferPool
+class BufferBlock {
+public:
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    size_t capacity() const { return capacity_; }
+
+    void retain() { refCount_.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+
+    // True if someone besides the caller still references this block
+    bool isShared() const { return refCount_.load(std::memory_order_acquire) > 1; }
+
+private:
+    friend class BufferPool;
+
+    // Where the block's memory came from, decides how it is freed
+    enum Origin : uint8_t {
+        HEAP,   // operator new
+        ARENA   // carved from a huge page arena, never freed
+    };
+
+    BufferBlock(BufferPool* pool, size_t capacity, uint8_t sizeClass, Origin origin)
+        : pool_(pool), refCount_(1), sizeClass_(sizeClass), origin_(origin),
+          capacity_(capacity) {}
+
+    BufferPool* pool_;
+    std::atomic<int> refCount_;
+    uint8_t sizeClass_;   // BUFFER_SIZE_CLASSES for oversize blocks
+    Origin origin_;
+    size_t capacity_;
+};
+
+// Intrusive smart pointer to a BufferBlock, copying only bumps the refcount
+class BufferRef {
+public:
+    BufferRef() : block_(nullptr) {}
+    explicit BufferRef(BufferBlock* block) : block_(block) {}  // adopts a reference
+    BufferRef(const BufferRef& other) : block_(other.block_) {
+        if (block_) {
+            block_->retain();
+        }
+    }
+    BufferRef(BufferRef&& other) : block_(other.block_) { other.block_ = nullptr; }
+    ~BufferRef() { reset(); }
+
+    BufferRef& operator=(BufferRef other) {
+        std::swap(block_, other.block_);
+        return *this;
+    }
+
+    void reset() {
+        if (block_) {
+            block_->release();
+            block_ = nullptr;
+        }
+    }
+
+    BufferBlock* get() const { return block_; }
+    BufferBlock* operator->() const { return block_; }
+    explicit operator bool() const { return block_ != nullptr; }
+
+private:
+    BufferBlock* block_;
+};
+
+// Size classes: 4 KB, 16 KB, ... 16 MB, each four times the previous
+constexpr size_t BUFFER_MIN_CLASS_SIZE = 4 * 1024;
+constexpr size_t BUFFER_SIZE_CLASSES = 7;
+
+// Usage of one size class, for sizing the pool
+struct BufferPoolStats {
+    size_t blockSize = 0;      // 0 for the oversize row
+    size_t freeBlocks = 0;     // cached, ready for reuse
+    size_t liveBlocks = 0;     // handed out and not yet released
+    uint64_t acquires = 0;
+    uint64_t misses = 0;       // acquires that had to allocate
+};
+
+// Pool of refcounted blocks in power-of-four size classes. Each class
+// keeps its own free list and lock; requests above the largest class
+// get a dedicated block that is freed instead of recycled.
+// With huge pages, classes up to 256 KB are carved from 2 MB arenas
+// (MAP_HUGETLB, falling back to transparent huge pages); arena blocks
+// stay cached for the lifetime of the pool.
+class BufferPool {
+public:
+    explicit BufferPool(size_t maxFreeBytesPerClass = 32 * 1024 * 1024,
+                        bool hugePages = false);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Get a block with at least minSize bytes of capacity
+    BufferRef acquire(size_t minSize);
+
+    // Capacity of the smallest class holding minSize bytes, or minSize
+    // itself when it is above every class
+    static size_t roundUp(size_t minSize);
+
+    bool usesHugePages() const { return hugePages_; }
+
+    // Number of blocks currently cached, over all classes
+    size_t getFreeBlockCount() const;
+
+    // One row per size class, then one for oversize blocks
+    std::vector<BufferPoolStats> getStats() const;
+
+    // Process-wide pool used by receive buffers and send queues
+    static BufferPool& defaultPool();
+
+    // Back the default pool with huge pages. Only effective before the
+    // first defaultPool() call.
+    static void setDefaultHugePages(bool enable);
+
+private:
+    friend class BufferBlock;
+
+    struct SizeClass {
+        size_t blockSize = 0;
+        size_t maxFreeBlocks = 0;
+        mutable std::mutex mutex;
+        std::vector<BufferBlock*> freeBlocks;
+        std::atomic<uint64_t> acquires{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<int64_t> live{0};
+    };
+
+    static size_t classIndex(size_t minSize);
+
+    BufferBlock* allocateBlock(size_t capacity, size_t sizeClass);
+    void refillFromArena(SizeClass& cls, size_t sizeClass);
+    void recycle(BufferBlock* block);
+    static void freeBlock(BufferBlock* block);
+
+    bool hugePages_;
+    SizeClass classes_[BUFFER_SIZE_CLASSES];
+    std::atomic<uint64_t> oversizeAcquires_;
+    std::atomic<int64_t> oversizeLive_;
+
+    std::mutex arenaMutex_;
+    std::vector<std::pair<void*, size_t>> arenas_;
+};
+
+inline void BufferBlock::release() {
+    if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool_->recycle(this);
+    }
+}
+
+} // namespace tcp_server
@@ -1,63 +1,81 @@
 #pragma once
 
-#include "Session.h"
-#include "SessionManager.h"
-#include "MessageDispatcher.h"
+#include "EventLoop.h"
+#include <sys/epoll.h>
 #include <memory>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 namespace tcp_server {
 
-class EpollServer {
+class EpollServer : public EventLoop {
 public:
-    using NewConnectionCallback = std::function<void(SessionPtr)>;
-    using MessageCallback = std::function<void(SessionPtr, const MessageHeader&, 
-                                               const std::vector<char>&)>;
-    using DisconnectCallback = std::function<void(int)>;
+    // id identifies this reactor when several share one port;
+    // reusePort enables SO_REUSEPORT so each reactor owns its own listen socket
+    explicit EpollServer(const EventLoopConfig& config, int id = 0, bool reusePort = false);
+    ~EpollServer() override;
 
-    explicit EpollServer(int port);
-    ~EpollServer();
+    bool start() override;
+    void stop() override;
+    void runOnce(int timeoutMs = 100) override;
+    void closeConnection(const SessionPtr& session) override;
+    void pauseReading(const SessionPtr& session) override;
+    void resumeReading(const SessionPtr& session) override;
+    void queueInLoop(Functor functor) override;
 
-    // Set callbacks
-    void setNewConnectionCallback(NewConnectionCallback cb) { 
-        newConnectionCb_ = cb; 
-    }
-    void setMessageCallback(MessageCallback cb) { 
-        messageCb_ = cb; 
-    }
-    void setDisconnectCallback(DisconnectCallback cb) { 
-        disconnectCb_ = cb; 
-    }
+    // Wake up a blocked epoll_wait
+    void wakeup() override;
 
-    // Start the server
-    bool start();
+    int getId() const override { return id_; }
+    void setWriteCoalescing(bool enable) override { config_.writeCoalescing = enable; }
+    void setReadBudget(size_t bytes, size_t messages) override;
 
-    // Stop the server
-    void stop();
-
-    // Run one iteration of event loop
-    void runOnce(int timeoutMs = 100);
-
-    // Close a client connection (can be called from upper layer)
-    void closeConnection(int fd);
+    // Schedule a flush of fd's outbound queue at the end of this
+    // loop iteration (thread-safe)
+    void requestFlush(int fd);
 
 private:
     bool createListenSocket();
+    // Busy poll the device queues in epoll_wait, best effort
+    void enableBusyPoll();
     bool setNonBlocking(int fd);
     void handleNewConnection();
-    void handleClientData(int fd);
+    // Returns true if the read budget ran out before the socket did
+    bool handleClientData(int fd);
+    // Returns false once budget messages were delivered, the rest wait
+    bool deliverMessages(const SessionPtr& session, size_t& budget);
+    void markReady(int fd);
+    void serviceReadyList();
+    void handleClientWrite(int fd);
+    void updateEvents(int fd, bool readable, bool writable);
     void handleClientDisconnect(int fd);
+    void handleWakeup();
+    void doPendingFunctors();
+    void doPendingFlushes();
 
-    int port_;
+    EventLoopConfig config_;
+    int id_;
+    bool reusePort_;
     int listenFd_;
     int epollFd_;
+    int wakeupFd_;
     bool running_;
+    std::vector<struct epoll_event> events_;
 
     std::map<int, SessionPtr> sessions_;
 
-    NewConnectionCallback newConnectionCb_;
-    MessageCallback messageCb_;
-    DisconnectCallback disconnectCb_;
+    // Connections that ran out of read budget with data left. Edge
+    // triggered epoll reports them no more, so the loop services them
+    // itself after each batch of events.
+    std::vector<int> readyList_;
+    std::unordered_set<int> readySet_;
+
+    std::mutex functorMutex_;
+    std::vector<Functor> pendingFunctors_;
+    std::vector<int> pendingFlushes_;
 };
 
 using EpollServerPtr = std::shared_ptr<EpollServer>;
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Session.h"
+#include "Message.h"
+#include <functional>
+#include <memory>
+
+namespace tcp_server {
+
+// I/O backend used by the reactors
+enum class IoBackend {
+    EPOLL,     // EpollServer: readiness notifications plus recv/send syscalls
+    IO_URING   // IoUringServer: completion-based, batched submissions
+};
+
+// Default per-connection read budget for one loop iteration
+constexpr size_t DEFAULT_READ_BUDGET_BYTES = 64 * 1024;
+constexpr size_t DEFAULT_READ_BUDGET_MESSAGES = 64;
+
+// Listen socket, accepted sockets and event loop tuning of one reactor.
+// Socket options are set on the listen socket, accepted connections
+// inherit them. A value of 0 leaves the kernel default.
+struct EventLoopConfig {
+    int port = 8888;
+    int listenBacklog = 128;         // capped by net.core.somaxconn
+    int deferAcceptSeconds = 0;      // TCP_DEFER_ACCEPT: accept once data arrives
+    bool tcpNoDelay = false;         // TCP_NODELAY: no Nagle delay on small replies
+    int recvBufferBytes = 0;         // SO_RCVBUF
+    int sendBufferBytes = 0;         // SO_SNDBUF
+    int busyPollUs = 0;              // SO_BUSY_POLL, and epoll busy polling on epoll
+
+    int maxEvents = 1024;            // events taken per epoll_wait
+    size_t recvChunkBytes = 4096;    // free space ensured before each recv
+    int pollTimeoutMs = 100;         // longest wait for events in runOnce()
+    size_t readBudgetBytes = DEFAULT_READ_BUDGET_BYTES;
+    size_t readBudgetMessages = DEFAULT_READ_BUDGET_MESSAGES;
+    bool writeCoalescing = false;
+};
+
+// One reactor: owns a listen socket and the connections accepted on it,
+// and runs on a single thread driven by runOnce()
+class EventLoop {
+public:
+    using NewConnectionCallback = std::function<void(SessionPtr)>;
+    using MessageCallback = std::function<void(SessionPtr, const Message&)>;
+    // Called with the closing session before its fd is released for reuse
+    using DisconnectCallback = std::function<void(const SessionPtr&)>;
+    using Functor = std::function<void()>;
+
+    virtual ~EventLoop() = default;
+
+    // Set callbacks
+    void setNewConnectionCallback(NewConnectionCallback cb) {
+        newConnectionCb_ = cb;
+    }
+    void setMessageCallback(MessageCallback cb) {
+        messageCb_ = cb;
+    }
+    void setDisconnectCallback(DisconnectCallback cb) {
+        disconnectCb_ = cb;
+    }
+
+    // Start the server
+    virtual bool start() = 0;
+
+    // Stop the server
+    virtual void stop() = 0;
+
+    // Run one iteration of event loop
+    virtual void runOnce(int timeoutMs = 100) = 0;
+
+    // Close a client connection (can be called from upper layer, any thread).
+    // A no-op once the session's fd belongs to a newer connection.
+    virtual void closeConnection(const SessionPtr& session) = 0;
+
+    // Run a functor on the event loop thread (thread-safe)
+    virtual void queueInLoop(Functor functor) = 0;
+
+    // Wake up a blocked wait for events
+    virtual void wakeup() = 0;
+
+    // Stop or resume reading a connection's socket, loop thread only.
+    // Messages already received are held back until resumed.
+    virtual void pauseReading(const SessionPtr& session) = 0;
+    virtual void resumeReading(const SessionPtr& session) = 0;
+
+    // Reactor id
+    virtual int getId() const = 0;
+
+    // Coalesce all messages queued for a session during one loop
+    // iteration into a single write (applies to new connections)
+    virtual void setWriteCoalescing(bool enable) = 0;
+
+    // Most bytes read and messages delivered per connection per loop
+    // iteration, so one busy client cannot hold up the others
+    virtual void setReadBudget(size_t bytes, size_t messages) = 0;
+
+    // Whether the calling thread is inside this loop's runOnce()
+    bool isInLoopThread() const;
+
+protected:
+    // Marks the calling thread as running the loop for its lifetime,
+    // declared at the top of runOnce()
+    class LoopScope {
+    public:
+        explicit LoopScope(EventLoop* loop);
+        ~LoopScope();
+
+        LoopScope(const LoopScope&) = delete;
+        LoopScope& operator=(const LoopScope&) = delete;
+
+    private:
+        EventLoop* previous_;
+    };
+
+    NewConnectionCallback newConnectionCb_;
+    MessageCallback messageCb_;
+    DisconnectCallback disconnectCb_;
+};
+
+using EventLoopPtr = std::shared_ptr<EventLoop>;
+
+// Create a reactor using the given backend
+EventLoopPtr createEventLoop(IoBackend backend, const EventLoopConfig& config, int id,
+                             bool reusePort);
+
+// Parse "epoll" / "uring", returns false on unknown names
+bool parseIoBackend(const char* name, IoBackend& backend);
+
+// Bound, listening, non-blocking TCP socket on config.port with the
+// configured socket options, or -1
+int openListenSocket(const EventLoopConfig& config, bool reusePort);
+
+} // namespace tcp_server
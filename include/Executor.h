@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Priority.h"
+#include "Task.h"
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace tcp_server {
+
+// Task scheduler used by the server to run message handlers
+enum class SchedulerType {
+    GLOBAL_QUEUE,   // ThreadPool: one queue shared by all workers
+    WORK_STEALING   // WorkStealingThreadPool: per-worker deques
+};
+
+// Thread pool settings
+struct ExecutorConfig {
+    SchedulerType scheduler = SchedulerType::GLOBAL_QUEUE;
+    size_t threadCount = 4;
+    // Pin worker i to CPU firstCpu + i (wrapping around the online CPUs),
+    // -1 leaves placement to the kernel
+    int firstCpu = -1;
+    // Slots of the work-stealing pool's lock-free injection queue, tasks
+    // beyond it go to a locked overflow queue
+    size_t injectionQueueCapacity = 65536;
+};
+
+// A task plus the time it was submitted and its class, for queue wait metrics
+struct QueuedTask {
+    QueuedTask() : enqueuedNs(0), priority(Priority::NORMAL) {}
+    QueuedTask(Task t, int64_t ns, Priority p = Priority::NORMAL)
+        : task(std::move(t)), enqueuedNs(ns), priority(p) {}
+
+    Task task;
+    int64_t enqueuedNs;
+    Priority priority;
+};
+
+// Common interface of the thread pools
+class Executor {
+public:
+    using Task = tcp_server::Task;
+
+    virtual ~Executor() = default;
+
+    // Submit a task of the given priority class
+    virtual void submit(Task task, Priority priority) = 0;
+
+    // Submit a NORMAL priority task
+    void submit(Task task) { submit(std::move(task), Priority::NORMAL); }
+
+    // Get number of threads
+    virtual size_t getThreadCount() const = 0;
+
+    // Get pending task count
+    virtual size_t getPendingTaskCount() const = 0;
+};
+
+using ExecutorPtr = std::shared_ptr<Executor>;
+
+// Default settings for a pool of the given type and size
+ExecutorConfig executorConfig(SchedulerType type, size_t threadCount);
+
+// Create an executor of the given type
+ExecutorPtr createExecutor(SchedulerType type, size_t threadCount);
+ExecutorPtr createExecutor(const ExecutorConfig& config);
+
+// Apply config.firstCpu to the index-th worker thread, best effort
+void pinWorkerThread(std::thread& thread, const ExecutorConfig& config, size_t index);
+
+// Parse "queue" / "stealing", returns false on unknown names
+bool parseSchedulerType(const char* name, SchedulerType& type);
+
+} // namespace tcp_server
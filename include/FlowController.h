@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Session.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace tcp_server {
+
+// High/low watermarks on inbound messages waiting for the thread pools.
+// Reading a session stops once it (or the whole server) reaches a high
+// watermark, and resumes when it is back under the low ones.
+// A high watermark of 0 disables that limit.
+struct BackpressureConfig {
+    size_t sessionHighTasks = 1024;
+    size_t sessionLowTasks = 256;
+    size_t sessionHighBytes = 16 * 1024 * 1024;
+    size_t sessionLowBytes = 4 * 1024 * 1024;
+
+    size_t globalHighTasks = 64 * 1024;
+    size_t globalLowTasks = 16 * 1024;
+    size_t globalHighBytes = 256 * 1024 * 1024;
+    size_t globalLowBytes = 64 * 1024 * 1024;
+};
+
+// Tracks queued inbound work per session and in total, and turns
+// overload into TCP backpressure by pausing reads on the sockets.
+class FlowController {
+public:
+    // Stop reading a session, called on its reactor thread
+    using PauseCallback = std::function<void(const SessionPtr&)>;
+    // Resume reading a session, called from any thread
+    using ResumeCallback = std::function<void(const SessionPtr&)>;
+
+    FlowController(PauseCallback pauseCb, ResumeCallback resumeCb);
+    ~FlowController() = default;
+
+    // Replace the watermarks, call before the server starts
+    void setConfig(const BackpressureConfig& config) { config_ = config; }
+    const BackpressureConfig& getConfig() const { return config_; }
+
+    // A message of bytes was queued for session, on the reactor thread
+    // before the task is posted
+    void onQueued(const SessionPtr& session, size_t bytes);
+
+    // A message queued by onQueued() has been handled, on any thread
+    void onDone(const SessionPtr& session, size_t bytes);
+
+    // Pause reading session until endDeferral(), on its reactor thread.
+    // Used by admission control while the server is overloaded.
+    void defer(const SessionPtr& session);
+
+    // Overload is over, resume deferred sessions that are below their
+    // own low watermarks; on any thread
+    void endDeferral();
+
+    // Whether reads of session should stay paused, for the reactor to
+    // check before acting on a resume
+    bool isPaused(const SessionPtr& session) const;
+
+    // Forget a closed session
+    void removeSession(const SessionPtr& session);
+
+    size_t getQueuedTasks() const { return queuedTasks_.load(std::memory_order_relaxed); }
+    size_t getQueuedBytes() const { return queuedBytes_.load(std::memory_order_relaxed); }
+    size_t getPausedCount() const;
+
+private:
+    bool sessionAboveHigh(const Session::FlowState& flow) const;
+    bool sessionBelowLow(const Session::FlowState& flow) const;
+    void resumeAll();
+
+    BackpressureConfig config_;
+    PauseCallback pauseCb_;
+    ResumeCallback resumeCb_;
+
+    std::atomic<size_t> queuedTasks_;
+    std::atomic<size_t> queuedBytes_;
+    // Set at a global high watermark, cleared at the low ones
+    std::atomic<bool> overloaded_;
+    // Set by defer(), cleared by endDeferral()
+    std::atomic<bool> deferring_;
+
+    // Every session whose reads are paused
+    mutable std::mutex pausedMutex_;
+    std::unordered_set<SessionPtr> paused_;
+};
+
+using FlowControllerPtr = std::shared_ptr<FlowController>;
+
+} // namespace tcp_server
@@ -2,26 +2,58 @@
 
 #include "Session.h"
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <chrono>
 
 namespace tcp_server {
 
+// Tracks heartbeat deadlines on a hashed timing wheel: every session sits
+// in the slot of the tick its deadline falls on. Rescheduling moves it
+// between slots in O(1) and a tick only visits the sessions expiring in it.
 class HeartbeatManager {
 public:
     explicit HeartbeatManager(int timeoutSeconds = 10);
     ~HeartbeatManager() = default;
 
-    // Update heartbeat for a session
+    // Update heartbeat for a session, (re)scheduling its deadline
     void updateHeartbeat(SessionPtr session);
 
-    // Check for timed out sessions
-    std::vector<int> checkTimeouts(const std::vector<SessionPtr>& sessions);
+    // Stop tracking a session, entries of other sessions on its fd are kept
+    void removeSession(const SessionPtr& session);
+
+    // Advance the wheel to the current time
+    // Returns the sessions whose deadline passed and that are still alive
+    std::vector<SessionPtr> tick();
 
     // Get timeout duration
     int getTimeoutSeconds() const { return timeoutSeconds_; }
 
+    // Number of sessions being tracked
+    size_t getTrackedCount() const;
+
 private:
+    using SlotList = std::list<int>;
+
+    struct Entry {
+        std::weak_ptr<Session> session;
+        size_t slot;
+        uint64_t deadline;  // tick at which the session expires
+        SlotList::iterator position;
+    };
+
+    // Tick of a deadline one timeout from now, rounded up
+    uint64_t deadlineTick() const;
+
     int timeoutSeconds_;
+    size_t timeoutTicks_;
+    std::chrono::steady_clock::time_point startTime_;
+    uint64_t currentTick_;
+
+    std::vector<SlotList> slots_;
+    std::unordered_map<int, Entry> entries_;
+    mutable std::mutex mutex_;
 };
 
 using HeartbeatManagerPtr = std::shared_ptr<HeartbeatManager>;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace tcp_server {
+
+// Minimal io_uring ring on top of the raw syscalls (no liburing).
+// Single-threaded: only the owning reactor thread may touch it.
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Create the ring with sqEntries submission and cqEntries completion slots
+    bool init(unsigned sqEntries, unsigned cqEntries);
+
+    // Unmap and close the ring, cancelling whatever is still in flight
+    void close();
+
+    bool isOpen() const { return ringFd_ >= 0; }
+
+    // Zeroed SQE to fill in, submits queued entries first when the
+    // submission queue is full. nullptr only if the kernel rejects them.
+    struct io_uring_sqe* getSqe();
+
+    // Hand queued SQEs to the kernel and wait up to timeoutMs for at least
+    // one completion (0 does not wait). Returns the io_uring_enter result.
+    int submitAndWait(int timeoutMs);
+
+    // Call fn(const io_uring_cqe&) for every available completion
+    template <typename Fn>
+    unsigned forEachCqe(Fn fn) {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        while (head != tail) {
+            // Copy out, the slot is free again once head moves past it
+            struct io_uring_cqe cqe = cqes_[head & cqMask_];
+            ++head;
+            ++count;
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+            fn(cqe);
+            tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        }
+        return count;
+    }
+
+private:
+    // Publish SQEs handed out since the last submit, returns their count
+    unsigned flushSq();
+
+    int ringFd_;
+
+    // Submission queue
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqArray_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    struct io_uring_sqe* sqes_;
+    unsigned sqeTail_;       // next SQE to hand out
+    unsigned sqeSubmitted_;  // SQEs already published to the kernel
+
+    // Completion queue
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    size_t sqesSize_;
+};
+
+} // namespace tcp_server
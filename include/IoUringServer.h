@@ -0,0 +1,126 @@
+#pragma once
+
+#include "EventLoop.h"
+#include "IoUring.h"
+#include "OutputQueue.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace tcp_server {
+
+// Completion-based reactor on io_uring. One multishot accept feeds new
+// connections, each connection has one multishot recv drawing from a
+// shared pool of kernel-provided buffers, and outbound queues are written
+// with SENDMSG requests that go to the kernel together with the next
+// wait, so a loop iteration costs a single io_uring_enter.
+// Sessions always run in write-coalescing mode: replies are flushed by
+// the reactor, never written from worker threads.
+class IoUringServer : public EventLoop {
+public:
+    // Completions report no event count and the provided recv buffers
+    // are config.recvChunkBytes each, maxEvents does not apply
+    explicit IoUringServer(const EventLoopConfig& config, int id = 0, bool reusePort = false);
+    ~IoUringServer() override;
+
+    bool start() override;
+    void stop() override;
+    void runOnce(int timeoutMs = 100) override;
+    void closeConnection(const SessionPtr& session) override;
+    void pauseReading(const SessionPtr& session) override;
+    void resumeReading(const SessionPtr& session) override;
+    void queueInLoop(Functor functor) override;
+    void wakeup() override;
+    int getId() const override { return id_; }
+
+    // Writes are always coalesced on this backend
+    void setWriteCoalescing(bool) override {}
+
+    // Completions already arrive in recv buffer sized slices, interleaved
+    // across connections; only the message budget applies
+    void setReadBudget(size_t bytes, size_t messages) override;
+
+    // Schedule a flush of fd's outbound queue at the end of this
+    // loop iteration (thread-safe)
+    void requestFlush(int fd);
+
+private:
+    // Per-connection state referenced by in-flight requests. Freed once
+    // the connection is closed and its last request has completed.
+    struct Connection {
+        int fd;
+        SessionPtr session;
+        bool closed;
+        bool recvArmed;                          // multishot recv in flight
+        int pendingOps;
+        struct msghdr msg;                       // in-flight SENDMSG
+        struct iovec iov[MAX_IOV_PER_WRITE];
+    };
+
+    // Request kind, kept in the low bits of user_data
+    enum OpType : uint64_t {
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_SEND = 3,
+        OP_WAKEUP = 4,
+        OP_PROVIDE = 5,
+        OP_CANCEL = 6
+    };
+
+    // Hand count recv buffers starting at firstId to the kernel
+    void provideBuffers(uint16_t firstId, uint16_t count);
+    void armAccept();
+    bool armRecv(Connection* conn);
+    void armWakeup();
+    void submitSend(Connection* conn);
+    void handleCompletion(const struct io_uring_cqe& cqe);
+    void handleAccept(const struct io_uring_cqe& cqe);
+    void handleRecv(Connection* conn, const struct io_uring_cqe& cqe);
+    void handleSend(Connection* conn, const struct io_uring_cqe& cqe);
+    // Returns false once the message budget is spent, the rest wait on
+    // the ready list
+    bool deliverMessages(Connection* conn);
+    void markReady(int fd);
+    void serviceReadyList();
+    // Closes the socket but never frees conn: every handler that may
+    // disconnect calls releaseIfDone() once it is done with conn
+    void handleClientDisconnect(Connection* conn);
+    // Connection of session on this reactor, nullptr if it is gone
+    Connection* findConnection(const SessionPtr& session);
+    void releaseIfDone(Connection* conn);
+    void doPendingFunctors();
+    void doPendingFlushes();
+    void releaseResources();
+
+    EventLoopConfig config_;
+    int id_;
+    bool reusePort_;
+    int listenFd_;
+    int wakeupFd_;
+    // Atomic because stop() may run from a signal handler on the loop thread
+    std::atomic<bool> running_;
+    std::atomic<bool> inLoop_;
+    uint64_t wakeupValue_;
+
+    IoUring ring_;
+
+    // Provided buffers for multishot recv
+    std::unique_ptr<char[]> bufferMemory_;
+
+    std::unordered_map<int, Connection*> connections_;
+
+    // Connections holding complete messages beyond their budget
+    std::vector<int> readyList_;
+    std::unordered_set<int> readySet_;
+
+    std::mutex functorMutex_;
+    std::vector<Functor> pendingFunctors_;
+    std::vector<int> pendingFlushes_;
+};
+
+} // namespace tcp_server
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <string>
+
+// Levels below this are compiled out entirely (0 = TRACE ... 5 = OFF)
+#ifndef TCP_SERVER_MIN_LOG_LEVEL
+#define TCP_SERVER_MIN_LOG_LEVEL 0
+#endif
+
+namespace tcp_server {
+
+enum class LogLevel : int {
+    TRACE = 0,
+    DEBUG = 1,
+    INFO = 2,
+    WARN = 3,
+    ERROR = 4,
+    OFF = 5
+};
+
+// Maximum formatted length of one log line, longer lines are truncated
+constexpr size_t LOG_LINE_SIZE = 256;
+
+// Parse "trace" / "debug" / "info" / "warn" / "error" / "off"
+bool parseLogLevel(const char* name, LogLevel& level);
+
+// Asynchronous logger. Every thread formats into its own lock-free
+// single-producer ring; a background thread drains the rings and writes
+// INFO and below to stdout, WARN and above to stderr. When a ring is
+// full the record is dropped and counted rather than blocking the caller.
+class Logger {
+public:
+    static Logger& instance();
+
+    bool isEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    LogLevel getLevel() const { return static_cast<LogLevel>(level_.load()); }
+    void setLevel(LogLevel level) { level_.store(static_cast<int>(level)); }
+
+    // Queue a formatted line from the calling thread
+    void write(LogLevel level, const char* text, size_t len);
+
+    // Block until everything logged so far has been written
+    void flush();
+
+    // Drain and stop the writer thread (also run at exit)
+    void shutdown();
+
+    // Records dropped because a thread's ring was full
+    uint64_t getDroppedCount() const { return dropped_.load(); }
+
+private:
+    Logger();
+    ~Logger() = delete;
+
+    struct Impl;
+
+    std::atomic<int> level_;
+    std::atomic<uint64_t> dropped_;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Raw bytes to log, e.g. a message body
+struct LogBytes {
+    LogBytes(const char* d, size_t n) : data(d), len(n) {}
+    const char* data;
+    size_t len;
+};
+
+// Formats into a fixed stack buffer, no allocation
+class LogStream {
+public:
+    LogStream() : len_(0), hex_(false) {}
+
+    LogStream& operator<<(const char* value);
+    LogStream& operator<<(const std::string& value) {
+        append(value.data(), value.size());
+        return *this;
+    }
+    LogStream& operator<<(const LogBytes& value) {
+        append(value.data, value.len);
+        return *this;
+    }
+    LogStream& operator<<(char value) {
+        append(&value, 1);
+        return *this;
+    }
+    LogStream& operator<<(bool value) { return *this << (value ? "true" : "false"); }
+    LogStream& operator<<(short value) { return formatSigned(value); }
+    LogStream& operator<<(unsigned short value) { return formatUnsigned(value); }
+    LogStream& operator<<(int value) { return formatSigned(value); }
+    LogStream& operator<<(unsigned int value) { return formatUnsigned(value); }
+    LogStream& operator<<(long value) { return formatSigned(value); }
+    LogStream& operator<<(unsigned long value) { return formatUnsigned(value); }
+    LogStream& operator<<(long long value) { return formatSigned(value); }
+    LogStream& operator<<(unsigned long long value) { return formatUnsigned(value); }
+    LogStream& operator<<(double value);
+    LogStream& operator<<(const void* value);
+
+    // Honors std::hex and std::dec for integers
+    LogStream& operator<<(std::ios_base& (*manip)(std::ios_base&));
+
+    const char* data() const { return buffer_; }
+    size_t length() const { return len_; }
+
+    void append(const char* data, size_t len);
+
+private:
+    LogStream& formatSigned(long long value);
+    LogStream& formatUnsigned(unsigned long long value);
+
+    char buffer_[LOG_LINE_SIZE];
+    size_t len_;
+    bool hex_;
+};
+
+// One log statement, handed to the logger when destroyed
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level_(level) {}
+    ~LogLine() { Logger::instance().write(level_, stream_.data(), stream_.length()); }
+
+    LogStream& stream() { return stream_; }
+
+private:
+    LogLevel level_;
+    LogStream stream_;
+};
+
+} // namespace tcp_server
+
+// Arguments are not evaluated when the level is disabled
+#define TCP_LOG(level)                                                        \
+    if (static_cast<int>(level) < TCP_SERVER_MIN_LOG_LEVEL ||                 \
+        !::tcp_server::Logger::instance().isEnabled(level)) {                 \
+    } else                                                                    \
+        ::tcp_server::LogLine(level).stream()
+
+#define LOG_TRACE TCP_LOG(::tcp_server::LogLevel::TRACE)
+#define LOG_DEBUG TCP_LOG(::tcp_server::LogLevel::DEBUG)
+#define LOG_INFO TCP_LOG(::tcp_server::LogLevel::INFO)
+#define LOG_WARN TCP_LOG(::tcp_server::LogLevel::WARN)
+#define LOG_ERROR TCP_LOG(::tcp_server::LogLevel::ERROR)
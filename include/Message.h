@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Protocol.h"
+#include "BufferPool.h"
+
+namespace tcp_server {
+
+// A received message: the header plus a view of its body inside the
+// receive buffer. Copying a Message only bumps the buffer's refcount,
+// the body bytes are never copied.
+class Message {
+public:
+    Message() : body_(nullptr), arrivalNs_(0) {}
+
+    Message(const MessageHeader& header, const BufferRef& buffer, const char* body)
+        : header_(header)
+        , buffer_(buffer)
+        , body_(body)
+        , arrivalNs_(0) {}
+
+    const MessageHeader& getHeader() const { return header_; }
+
+    MessageType getType() const { return static_cast<MessageType>(header_.type); }
+
+    // Body bytes, nullptr when the message has no body
+    const char* getBody() const { return body_; }
+    size_t getBodyLength() const { return body_ ? header_.bodyLength : 0; }
+
+    // metricsNowNs() when the reactor handed the message to the server,
+    // 0 if never stamped
+    int64_t getArrivalNs() const { return arrivalNs_; }
+    void setArrivalNs(int64_t arrivalNs) { arrivalNs_ = arrivalNs; }
+
+private:
+    MessageHeader header_;
+    BufferRef buffer_;
+    const char* body_;
+    int64_t arrivalNs_;
+};
+
+} // namespace tcp_server
@@ -1,30 +1,142 @@
 #pragma once
 
 #include "Protocol.h"
+#include "Message.h"
+#include "Priority.h"
 #include "Session.h"
 #include "SessionManager.h"
 #include "HeartbeatManager.h"
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace tcp_server {
 
+// Where a message handler runs
+enum class ExecutionPolicy {
+    INLINE,     // on the reactor thread, must not block
+    POOL,       // on the shared thread pool, in order per session
+    DEDICATED   // on a separate pool, in order per session
+};
+
+// Body type of handlers that decode no fixed struct, the raw body
+// (empty or variable length) is read from the Message
+struct NoBody {};
+
+// One slot per message type, indexed by header.type
+constexpr size_t HANDLER_TABLE_SIZE =
+    static_cast<size_t>(MessageType::MAX_MESSAGE_TYPE) + 1;
+
 class MessageDispatcher {
 public:
+    using Handler = std::function<void(const SessionPtr&, const Message&)>;
+    template <typename Body>
+    using TypedHandler = std::function<void(const SessionPtr&, const Body&, const Message&)>;
+
     MessageDispatcher(SessionManagerPtr sessionMgr, HeartbeatManagerPtr heartbeatMgr);
     ~MessageDispatcher() = default;
 
-    // Dispatch a message to appropriate handler
-    void dispatch(SessionPtr session, const MessageHeader& header, 
-                 const std::vector<char>& body);
+    // Register the handler of message type Type, replacing any previous
+    // one. The body is decoded into a Body once before the handler runs;
+    // messages whose body is shorter than Body are dropped.
+    // Not thread safe: register before the server starts.
+    template <MessageType Type, typename Body>
+    void registerHandler(ExecutionPolicy policy, TypedHandler<Body> handler) {
+        static_assert(Type != MessageType::UNKNOWN &&
+                      static_cast<size_t>(Type) < HANDLER_TABLE_SIZE,
+                      "message type out of range");
+        static_assert(std::is_trivially_copyable<Body>::value,
+                      "message body must be trivially copyable");
+
+        uint16_t type = static_cast<uint16_t>(Type);
+        registerRawHandler(type, policy,
+            [handler, type](const SessionPtr& session, const Message& message) {
+                Body body;
+                if (!decodeBody(message, body)) {
+                    reportShortBody(type, message.getBodyLength(), sizeof(Body));
+                    return;
+                }
+                handler(session, body, message);
+            });
+    }
+
+    // Register a handler that decodes the body itself, for types only
+    // known at runtime. Returns false if type is out of range.
+    bool registerRawHandler(uint16_t type, ExecutionPolicy policy, Handler handler);
+
+    // Policy of the handler for type, INLINE for types without a handler
+    // (they are only logged and counted)
+    ExecutionPolicy getPolicy(uint16_t type) const {
+        return type < HANDLER_TABLE_SIZE ? handlers_[type].policy : ExecutionPolicy::INLINE;
+    }
+
+    // Whether any registered handler uses policy
+    bool usesPolicy(ExecutionPolicy policy) const;
+
+    // Priority class of the pool task running type's handler, by default
+    // messagePriority(type). Returns false if type is out of range.
+    bool setPriority(uint16_t type, Priority priority);
+
+    Priority getPriority(uint16_t type) const {
+        return type < HANDLER_TABLE_SIZE ? handlers_[type].priority : Priority::NORMAL;
+    }
+
+    // Drop messages of type that waited longer than deadline since their
+    // arrival, before the handler runs. 0 (the default) never drops.
+    // Returns false for types that cannot be shed.
+    bool setDeadline(uint16_t type, std::chrono::milliseconds deadline);
+
+    // Allow overload handling to drop or defer messages of type.
+    // LOGIN_REQUEST and HEARTBEAT are never shed, every other type is
+    // by default. Returns false for types that cannot be changed.
+    bool setSheddable(uint16_t type, bool sheddable);
+
+    bool isSheddable(uint16_t type) const {
+        return type < HANDLER_TABLE_SIZE && handlers_[type].sheddable;
+    }
+
+    // Dispatch a message to its handler on the calling thread
+    void dispatch(SessionPtr session, const Message& message);
 
 private:
-    void handleLoginRequest(SessionPtr session, const std::vector<char>& body);
-    void handleHeartbeat(SessionPtr session);
-    void handleDataMessage(SessionPtr session, const std::vector<char>& body);
+    struct HandlerEntry {
+        Handler handler;  // empty when the type has no handler
+        ExecutionPolicy policy = ExecutionPolicy::INLINE;
+        Priority priority = Priority::NORMAL;
+        int64_t deadlineNs = 0;  // 0 when messages never expire
+        bool sheddable = true;
+    };
+
+    static bool neverShed(uint16_t type) {
+        return type == static_cast<uint16_t>(MessageType::LOGIN_REQUEST) ||
+               type == static_cast<uint16_t>(MessageType::HEARTBEAT);
+    }
+
+    template <typename Body>
+    static bool decodeBody(const Message& message, Body& body) {
+        if (message.getBodyLength() < sizeof(Body)) {
+            return false;
+        }
+        std::memcpy(&body, message.getBody(), sizeof(Body));
+        return true;
+    }
+
+    static bool decodeBody(const Message&, NoBody&) { return true; }
+
+    static void reportShortBody(uint16_t type, size_t bodyLength, size_t expected);
+
+    void handleLoginRequest(const SessionPtr& session, const LoginRequest& req);
+    void handleHeartbeatInline(const SessionPtr& session);
+    void handleHeartbeat(const SessionPtr& session);
+    void handleDataMessage(const SessionPtr& session, const Message& message);
 
     SessionManagerPtr sessionMgr_;
     HeartbeatManagerPtr heartbeatMgr_;
+    std::array<HandlerEntry, HANDLER_TABLE_SIZE> handlers_;
 };
 
 using MessageDispatcherPtr = std::shared_ptr<MessageDispatcher>;
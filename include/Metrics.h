@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Protocol.h"
+#include "Priority.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tcp_server {
+
+// Counters and histograms are split into stripes, every thread updates
+// the stripe it was assigned so hot metrics do not share a cache line
+constexpr size_t COUNTER_STRIPES = 8;
+constexpr size_t HISTOGRAM_STRIPES = 4;
+
+// Histogram buckets: exact below 2^SUB_BUCKET_BITS, then 16 buckets per
+// power of two (about 6% precision). Values of 2^36 ns (~68 s) and more
+// land in the last bucket.
+constexpr unsigned HISTOGRAM_SUB_BUCKET_BITS = 4;
+constexpr unsigned HISTOGRAM_MAX_BITS = 36;
+constexpr size_t HISTOGRAM_BUCKETS =
+    (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS;
+
+// Stripe of the calling thread, assigned round robin on first use
+inline size_t currentMetricStripe() {
+    static std::atomic<size_t> nextStripe(0);
+    thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed);
+    return stripe;
+}
+
+// Monotonic timestamp used for all latency metrics
+inline int64_t metricsNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Counter {
+public:
+    Counter();
+
+    void add(uint64_t n = 1) {
+        stripes_[currentMetricStripe() % COUNTER_STRIPES].value.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    // Sum over all stripes
+    uint64_t value() const;
+
+private:
+    // Padded rather than alignas(64), C++11 new ignores extended alignment
+    struct Stripe {
+        std::atomic<uint64_t> value;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    Stripe stripes_[COUNTER_STRIPES];
+};
+
+// Aggregated view of a histogram, values in the recorded unit
+struct HistogramSummary {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t mean = 0;
+    uint64_t max = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+};
+
+// HDR-style log-linear histogram with lock-free recording
+class Histogram {
+public:
+    Histogram();
+
+    void record(uint64_t value);
+
+    // Value at quantile q (0..1), reported as the bucket's upper bound
+    uint64_t percentile(double q) const;
+
+    HistogramSummary summarize() const;
+
+    // Merge all stripes into buckets (HISTOGRAM_BUCKETS entries), returns
+    // the total count. The difference of two copies covers the interval
+    // between them.
+    uint64_t mergeBuckets(uint64_t* buckets) const;
+    static uint64_t percentileOf(const uint64_t* buckets, uint64_t count, double q);
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    struct Stripe {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+        char padding[64];
+    };
+
+    std::unique_ptr<Stripe[]> stripes_;
+};
+
+// Point-in-time copy of every registered metric
+struct MetricsSnapshot {
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, uint64_t>> gauges;
+    std::vector<HistogramSummary> histograms;
+
+    // One "name value" line per counter and gauge, one line per histogram
+    std::string toString() const;
+};
+
+// Process-wide set of named metrics. Lookups take a lock, so callers
+// resolve the metric once and keep the reference; references stay valid
+// for the lifetime of the process.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    Counter& counter(const std::string& name);
+    Histogram& histogram(const std::string& name);
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    MetricsRegistry() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, std::unique_ptr<Counter>>> counters_;
+    std::vector<std::pair<std::string, std::unique_ptr<Histogram>>> histograms_;
+};
+
+// Slots for per-type metrics: the known message types, slot 0 for the rest
+constexpr size_t MESSAGE_TYPE_SLOTS = static_cast<size_t>(MessageType::BROADCAST) + 1;
+
+constexpr size_t VALIDATION_RESULT_SLOTS =
+    static_cast<size_t>(HeaderValidationResult::LENGTH_MISMATCH) + 1;
+
+// Metrics recorded by the server itself, resolved once at startup
+struct ServerMetrics {
+    static ServerMetrics& get();
+
+    static size_t typeSlot(uint16_t type) {
+        return type < MESSAGE_TYPE_SLOTS ? type : 0;
+    }
+
+    Counter* bytesIn;
+    Counter* bytesOut;
+    Counter* messages[MESSAGE_TYPE_SLOTS];
+    Histogram* dispatchTime[MESSAGE_TYPE_SLOTS];  // ns in MessageDispatcher::dispatch
+    Counter* validationFailures[VALIDATION_RESULT_SLOTS];
+    Histogram* queueWait;      // ns between submit and a worker picking the task up
+    Histogram* queueWaitByPriority[PRIORITY_COUNT];  // the same, per priority class
+    Counter* sendStalls;       // sends that found the socket full
+    Histogram* sendStallTime;  // ns until the output queue drained again
+    Counter* readPauses;       // sessions whose reads backpressure paused
+    Counter* expired[MESSAGE_TYPE_SLOTS];  // dropped past their deadline
+    Counter* shed[MESSAGE_TYPE_SLOTS];     // rejected by admission control
+    Counter* deferrals;        // sessions paused by admission control
+
+private:
+    ServerMetrics();
+};
+
+} // namespace tcp_server
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace tcp_server {
+
+// Usage of one object pool, for sizing it
+struct ObjectPoolStats {
+    std::string name;
+    size_t objectSize = 0;
+    size_t slabs = 0;
+    size_t inUse = 0;
+    size_t free = 0;
+    uint64_t allocations = 0;
+};
+
+// Slab allocator for objects of one size. Memory is taken from the heap
+// a slab at a time and threaded on a free list; freed objects go back on
+// the list and slabs are kept for the lifetime of the process.
+class FixedSizePool {
+public:
+    FixedSizePool(const std::string& name, size_t objectSize, size_t objectsPerSlab = 64);
+
+    FixedSizePool(const FixedSizePool&) = delete;
+    FixedSizePool& operator=(const FixedSizePool&) = delete;
+
+    void* allocate();
+    void deallocate(void* p);
+
+    ObjectPoolStats getStats() const;
+
+    // Stats of every pool created so far
+    static std::vector<ObjectPoolStats> collectStats();
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    void addSlab();
+
+    std::string name_;
+    size_t objectSize_;
+    size_t objectsPerSlab_;
+
+    mutable std::mutex mutex_;
+    FreeNode* freeList_;
+    size_t freeCount_;
+    std::vector<std::unique_ptr<char[]>> slabs_;
+    std::atomic<uint64_t> allocations_;
+};
+
+// Standard allocator drawing single objects from a FixedSizePool, one
+// pool per (type, Tag). Tag names the pool: struct Tag { static const
+// char* name(); }. Meant for std::allocate_shared, which rebinds it to
+// the control block type so object and refcounts share one slab slot.
+template <typename T, typename Tag>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, Tag>;
+    };
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(pool().allocate());
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        pool().deallocate(p);
+    }
+
+    // Leaked, objects may be released during static destruction
+    static FixedSizePool& pool() {
+        static FixedSizePool* instance = new FixedSizePool(Tag::name(), sizeof(T));
+        return *instance;
+    }
+};
+
+template <typename T, typename U, typename Tag>
+bool operator==(const PoolAllocator<T, Tag>&, const PoolAllocator<U, Tag>&) {
+    return true;
+}
+
+template <typename T, typename U, typename Tag>
+bool operator!=(const PoolAllocator<T, Tag>&, const PoolAllocator<U, Tag>&) {
+    return false;
+}
+
+} // namespace tcp_server
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "BufferPool.h"
+#include <deque>
+#include <sys/types.h>
+
+struct iovec;
+
+namespace tcp_server {
+
+// Maximum iovecs handed to one sendmsg() call
+constexpr size_t MAX_IOV_PER_WRITE = 64;
+
+// Urgent bytes written ahead of waiting normal messages before one normal
+// message goes first, so control replies cannot starve bulk data
+constexpr size_t MAX_URGENT_RUN_BYTES = 64 * 1024;
+
+// Outbound byte queue made of segments. Copied bytes are packed into
+// pooled blocks, refcounted blocks can be queued without copying, and
+// the whole queue is written with one scatter-gather call.
+// Messages go to one of two lanes: urgent messages are written ahead of
+// normal ones that have not started going out, never inside one.
+// Not thread-safe, Session guards it with its send mutex.
+class OutputQueue {
+public:
+    OutputQueue();
+    ~OutputQueue() = default;
+
+    // Copy data into the queue
+    void append(const char* data, size_t len, bool urgent = false);
+
+    // Queue a slice of a refcounted block without copying
+    void append(const BufferRef& block, const char* data, size_t len, bool urgent = false);
+
+    // The bytes appended to the lane since the last call make up one
+    // message. started: its first bytes were already written directly,
+    // so it has to finish before anything else.
+    void endMessage(bool urgent = false, bool started = false);
+
+    // Bytes waiting to be written
+    size_t size() const { return bytes_; }
+    bool empty() const { return bytes_ == 0; }
+
+    // Write as much as the socket accepts in one sendmsg() call
+    // Returns bytes written, or -1 with errno set
+    ssize_t writeTo(int fd);
+
+    // Describe the front of the queue in up to maxIov iovecs, for writes
+    // submitted asynchronously. Returns the number of iovecs filled.
+    // Messages appended afterwards do not change what consume() drops.
+    size_t fillIovecs(struct iovec* iov, size_t maxIov);
+
+    // Drop len bytes of the last fillIovecs() after they were written
+    void consume(size_t len);
+
+    // Drop everything
+    void clear();
+
+private:
+    struct Segment {
+        BufferRef block;
+        const char* data;
+        size_t len;
+    };
+
+    // Segments may hold the bytes of several messages, message ends are
+    // tracked by length
+    struct Lane {
+        Lane() : open(0), started(false) {}
+
+        std::deque<Segment> segments;
+        std::deque<size_t> messages;  // unwritten bytes of each message
+        size_t open;                  // bytes appended since endMessage()
+        bool started;                 // the front message is partly written
+    };
+
+    // Bytes of one lane in the order of the last fillIovecs()
+    struct Span {
+        Lane* lane;
+        size_t bytes;
+    };
+
+    Lane& laneFor(bool urgent) { return urgent ? urgent_ : normal_; }
+    Lane* leadLane();
+    size_t fillLane(const Lane& lane, size_t skip, size_t limit,
+                    struct iovec* iov, size_t maxIov, size_t& iovCount);
+    void consumeLane(Lane& lane, size_t len);
+
+    Lane urgent_;
+    Lane normal_;
+    Span plan_[3];
+    size_t planSpans_;
+    size_t urgentRun_;      // urgent bytes written while normal ones waited
+    BufferRef tailBlock_;   // block that copied bytes are packed into
+    size_t tailUsed_;
+    size_t bytes_;
+};
+
+} // namespace tcp_server
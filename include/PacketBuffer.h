@@ -1,11 +1,16 @@
 #pragma once
 
 #include "Protocol.h"
-#include <vector>
+#include "BufferPool.h"
+#include "Message.h"
 #include <memory>
 
 namespace tcp_server {
 
+// Receive buffer with read/write cursors over a pooled, refcounted block.
+// Extracted messages reference their body inside the block, so the
+// buffer never rewrites bytes while a message may still be reading them:
+// in that case it continues in a fresh block instead.
 class PacketBuffer {
 public:
     PacketBuffer();
@@ -16,16 +21,34 @@ public:
 
     // Try to extract a complete message from buffer
     // Returns true if a complete message is available
-    bool extractMessage(MessageHeader& header, std::vector<char>& body);
+    bool extractMessage(Message& message);
 
     // Clear the buffer
     void clear();
 
-    // Get current buffer size
-    size_t size() const { return buffer_.size(); }
+    // Get current buffer size (unread bytes)
+    size_t size() const { return writePos_ - readPos_; }
+
+    // Make sure at least len bytes of contiguous free space follow the
+    // write cursor, so data can be received directly into the buffer
+    void ensureWritable(size_t len);
+
+    // Free space after the write cursor
+    char* writeBegin() { return block_->data() + writePos_; }
+    size_t writableBytes() const { 
+        return block_ ? block_->capacity() - writePos_ : 0; 
+    }
+
+    // Commit len bytes written into writeBegin()
+    void hasWritten(size_t len) { writePos_ += len; }
 
 private:
-    std::vector<char> buffer_;
+    const char* readBegin() const { return block_->data() + readPos_; }
+    void retrieve(size_t len);
+
+    BufferRef block_;
+    size_t readPos_;
+    size_t writePos_;
 };
 
 } // namespace tcp_server
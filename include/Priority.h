@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Protocol.h"
+#include <cstddef>
+
+namespace tcp_server {
+
+// Priority class of queued work, higher classes are served first
+enum class Priority {
+    HIGH,    // control traffic: logins and heartbeats
+    NORMAL,  // data messages
+    LOW      // bulk work that can wait
+};
+
+constexpr size_t PRIORITY_COUNT = 3;
+
+// Times a class with queued work may be passed over for higher ones
+// before it is served anyway, so control traffic cannot starve the rest
+constexpr size_t MAX_PRIORITY_SKIPS = 16;
+
+inline size_t priorityIndex(Priority priority) {
+    return static_cast<size_t>(priority);
+}
+
+// Class of a message type, for its handler task and for replies of that
+// type on the way out
+inline Priority messagePriority(uint16_t type) {
+    switch (static_cast<MessageType>(type)) {
+        case MessageType::LOGIN_REQUEST:
+        case MessageType::LOGIN_RESPONSE:
+        case MessageType::HEARTBEAT:
+            return Priority::HIGH;
+        default:
+            return Priority::NORMAL;
+    }
+}
+
+// "high" / "normal" / "low"
+const char* priorityName(Priority priority);
+
+} // namespace tcp_server
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Executor.h"
+#include "RingDeque.h"
+
+namespace tcp_server {
+
+// One FIFO per priority class, popped highest class first. A class that
+// was passed over MAX_PRIORITY_SKIPS times while holding tasks goes first
+// on the next pop. Not thread-safe.
+class PriorityTaskQueue {
+public:
+    PriorityTaskQueue() : size_(0) {
+        for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+            skips_[i] = 0;
+        }
+    }
+
+    void push(QueuedTask task, Priority priority) {
+        queues_[priorityIndex(priority)].push_back(std::move(task));
+        ++size_;
+    }
+
+    // Next task by class and starvation order
+    bool pop(QueuedTask& task) {
+        size_t pick = PRIORITY_COUNT;
+        for (size_t i = 1; i < PRIORITY_COUNT; ++i) {
+            if (!queues_[i].empty() && skips_[i] >= MAX_PRIORITY_SKIPS) {
+                pick = i;
+                break;
+            }
+        }
+        for (size_t i = 0; i < PRIORITY_COUNT && pick == PRIORITY_COUNT; ++i) {
+            if (!queues_[i].empty()) {
+                pick = i;
+            }
+        }
+        if (pick == PRIORITY_COUNT) {
+            return false;
+        }
+
+        for (size_t i = pick + 1; i < PRIORITY_COUNT; ++i) {
+            if (!queues_[i].empty()) {
+                ++skips_[i];
+            }
+        }
+        skips_[pick] = 0;
+        popFrom(pick, task);
+        return true;
+    }
+
+    // Next task of one class, for callers that order the classes themselves
+    bool pop(QueuedTask& task, Priority priority) {
+        size_t index = priorityIndex(priority);
+        if (queues_[index].empty()) {
+            return false;
+        }
+        popFrom(index, task);
+        return true;
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t size(Priority priority) const { return queues_[priorityIndex(priority)].size(); }
+
+private:
+    void popFrom(size_t index, QueuedTask& task) {
+        task = std::move(queues_[index].front());
+        queues_[index].pop_front();
+        --size_;
+    }
+
+    RingDeque<QueuedTask> queues_[PRIORITY_COUNT];
+    size_t skips_[PRIORITY_COUNT];
+    size_t size_;
+};
+
+} // namespace tcp_server
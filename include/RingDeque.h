@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace tcp_server {
+
+// Double-ended queue on a growable ring buffer. Unlike std::deque it does
+// not allocate or free chunks as elements come and go; it only allocates
+// when it has to grow. Nothing is allocated before the first push.
+template <typename T>
+class RingDeque {
+public:
+    explicit RingDeque(size_t initialCapacity = 64)
+        : initialCapacity_(roundUp(initialCapacity))
+        , head_(0)
+        , size_(0) {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    T& front() { return slots_[head_]; }
+    T& back() { return slots_[(head_ + size_ - 1) & (slots_.size() - 1)]; }
+
+    void push_back(T value) {
+        if (size_ == slots_.size()) {
+            grow();
+        }
+        slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(value);
+        ++size_;
+    }
+
+    void pop_front() {
+        slots_[head_] = T();
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        --size_;
+    }
+
+    void pop_back() {
+        back() = T();
+        --size_;
+    }
+
+    void clear() {
+        while (!empty()) {
+            pop_front();
+        }
+        head_ = 0;
+    }
+
+private:
+    static size_t roundUp(size_t n) {
+        size_t capacity = 1;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    void grow() {
+        std::vector<T> slots(slots_.empty() ? initialCapacity_ : slots_.size() * 2);
+        for (size_t i = 0; i < size_; ++i) {
+            slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+        }
+        slots_.swap(slots);
+        head_ = 0;
+    }
+
+    size_t initialCapacity_;
+    std::vector<T> slots_;
+    size_t head_;
+    size_t size_;
+};
+
+} // namespace tcp_server
@@ -1,19 +1,36 @@
 #pragma once
 
-#include "EpollServer.h"
+#include "ServerConfig.h"
+#include "EventLoop.h"
 #include "SessionManager.h"
 #include "HeartbeatManager.h"
 #include "MessageDispatcher.h"
-#include "ThreadPool.h"
+#include "FlowController.h"
+#include "AdmissionController.h"
+#include "Executor.h"
+#include "Strand.h"
+#include "Metrics.h"
+#include "AdminServer.h"
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <vector>
 
 namespace tcp_server {
 
 class Server {
 public:
-    explicit Server(int port, int heartbeatTimeout = 10, size_t threadPoolSize = 4);
+    // reactorCount > 1 runs one reactor per thread, sharing the port
+    // through SO_REUSEPORT
+    // schedulerType picks the thread pool implementation
+    // ioBackend picks the reactor implementation (epoll or io_uring)
+    explicit Server(int port, int heartbeatTimeout = 10, size_t threadPoolSize = 4,
+                    size_t reactorCount = 1,
+                    SchedulerType schedulerType = SchedulerType::GLOBAL_QUEUE,
+                    IoBackend ioBackend = IoBackend::EPOLL);
+    // Everything else from config; its log level, huge pages and admin
+    // socket path are left to the caller
+    explicit Server(const ServerConfig& config);
     ~Server();
 
     // Start the server
@@ -22,11 +39,18 @@ public:
     // Stop the server
     void stop();
 
-    // Run the server (blocking)
+    // Run the server (blocking), drives reactor 0 on the calling thread
     void run();
 
+    // Make run() return, then call stop() from the thread that ran it.
+    // Async-signal-safe, for signal handlers.
+    void requestStop();
+
+    const ServerConfig& getConfig() const { return config_; }
+
     // Broadcast message to all authenticated clients
-    void broadcast(const MessageHeader& header, const char* body = nullptr);
+    // Returns how many sessions took the message, dropped it or are slow
+    BroadcastResult broadcast(const MessageHeader& header, const char* body = nullptr);
 
     // Send message to specific client by fd
     bool sendToClient(int fd, const MessageHeader& header, const char* body = nullptr);
@@ -40,23 +64,69 @@ public:
     // Get thread pool stats
     size_t getPendingTaskCount() const;
 
+    // Counters, gauges and latency percentiles aggregated over all threads
+    MetricsSnapshot getMetricsSnapshot() const;
+
+    // Serve getMetricsSnapshot() as text on a local Unix socket.
+    // Call after start(); the socket is removed by stop().
+    bool startAdminSocket(const std::string& path);
+
+    // Batch each session's replies into one write per reactor loop
+    // iteration. Call before start().
+    void setWriteCoalescing(bool enable);
+
+    // Get number of reactors
+    size_t getReactorCount() const { return reactors_.size(); }
+
+    // Most bytes read and messages delivered per connection per reactor
+    // loop iteration. Call before start().
+    void setReadBudget(size_t bytes, size_t messages);
+
+    // Watermarks for pausing reads when handlers fall behind.
+    // Call before start().
+    void setBackpressureConfig(const BackpressureConfig& config);
+
+    // When sheddable messages are rejected or deferred because tasks wait
+    // too long in the thread pools. Call before start().
+    void setAdmissionConfig(const AdmissionConfig& config);
+
+    // Message handler registry, register custom handlers before start()
+    MessageDispatcherPtr getDispatcher() const { return dispatcher_; }
+
+    // Threads of the pool running DEDICATED handlers, created by start()
+    // only if such a handler is registered. Call before start().
+    void setDedicatedPoolSize(size_t size) { config_.dedicatedPoolSize = size; }
+
 private:
     void onNewConnection(SessionPtr session);
-    void onMessage(SessionPtr session, const MessageHeader& header, 
-                   const std::vector<char>& body);
-    void onDisconnect(int fd);
+    void onMessage(SessionPtr session, const Message& message);
+    void onDisconnect(const SessionPtr& session);
+    bool admitMessage(const SessionPtr& session, const Message& message);
+    void dispatchMessage(const SessionPtr& session, const Message& message);
+    void onTaskDone(const SessionPtr& session, const Message& message);
+    void refreshAdmission(int64_t nowNs);
+    EventLoopPtr getReactor(const SessionPtr& session) const;
     void heartbeatCheckLoop();
+    void reactorLoop(EventLoopPtr reactor);
+    void closeConnection(const SessionPtr& session);
 
-    int port_;
+    ServerConfig config_;
     std::atomic<bool> running_;
+    std::atomic<bool> stopRequested_;
 
-    EpollServerPtr epollServer_;
+    std::vector<EventLoopPtr> reactors_;
     SessionManagerPtr sessionMgr_;
     HeartbeatManagerPtr heartbeatMgr_;
     MessageDispatcherPtr dispatcher_;
-    ThreadPoolPtr threadPool_;
+    FlowControllerPtr flowController_;
+    AdmissionControllerPtr admission_;
+    ExecutorPtr threadPool_;
+    ExecutorPtr dedicatedPool_;  // null unless a DEDICATED handler exists
+
+    AdminServerPtr adminServer_;
 
     std::unique_ptr<std::thread> heartbeatThread_;
+    std::vector<std::thread> reactorThreads_;
 };
 
 } // namespace tcp_server
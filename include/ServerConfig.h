@@ -0,0 +1,53 @@
+#pragma once
+
+#include "EventLoop.h"
+#include "Executor.h"
+#include "FlowController.h"
+#include "AdmissionController.h"
+#include "Logger.h"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace tcp_server {
+
+// Every tunable of a server, so a deployment can be set up for latency or
+// throughput from a config file and command line flags without recompiling
+struct ServerConfig {
+    EventLoopConfig loop;            // port, socket options, reactor loop
+    size_t reactorCount = 1;
+    IoBackend ioBackend = IoBackend::EPOLL;
+
+    ExecutorConfig pool;             // shared handler pool
+    size_t dedicatedPoolSize = 2;    // DEDICATED handler pool, if one is needed
+
+    int heartbeatTimeoutSeconds = 10;
+    BackpressureConfig backpressure;
+    AdmissionConfig admission;
+    std::map<uint16_t, int64_t> deadlinesMs;  // handler deadline by message type
+
+    // Process-wide, applied by the caller before the server is created
+    LogLevel logLevel = LogLevel::INFO;
+    bool hugePages = false;
+    std::string adminSocketPath;     // empty: AdminServer::defaultPath(port)
+};
+
+// Set one option by name, e.g. "socket.tcp_nodelay" to "on".
+// Returns false on unknown names and invalid values.
+bool setServerConfigOption(ServerConfig& config, const std::string& name,
+                           const std::string& value);
+
+// Apply "name = value" lines from a file, '#' starts a comment
+bool loadServerConfigFile(const std::string& path, ServerConfig& config);
+
+// Apply command line arguments in order: leading positional arguments
+// (port, threads, reactors, scheduler, log_level, io_backend, huge_pages),
+// then "--config <file>" and "--<name>=<value>" or "--<name> <value>".
+// Fails if the result is inconsistent, e.g. a low watermark not below its high one.
+bool parseServerConfigArgs(int argc, char* argv[], ServerConfig& config);
+
+// Option names with a short description, for usage messages
+void printServerConfigOptions(std::ostream& out);
+
+} // namespace tcp_server
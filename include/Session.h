@@ -1,30 +1,83 @@
 #pragma once
 
 #include "PacketBuffer.h"
+#include "OutputQueue.h"
 #include <memory>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+struct iovec;
 
 namespace tcp_server {
 
+class Strand;
+using StrandPtr = std::shared_ptr<Strand>;
+
+// Maximum bytes a session may hold in its outbound queue before sends fail
+constexpr size_t MAX_OUTPUT_BUFFER_SIZE = 64 * 1024 * 1024;
+
 class Session {
 public:
+    // Called with the events the reactor should watch: readable unless
+    // reads are paused, writable while the outbound queue needs EPOLLOUT
+    using InterestCallback = std::function<void(int, bool, bool)>;
+    // Called when a coalesced write needs a flush at the end of the loop iteration
+    using FlushRequestCallback = std::function<void(int)>;
+
+    // Inbound work queued for this session, kept by FlowController
+    struct FlowState {
+        std::mutex mutex;
+        size_t tasks = 0;
+        size_t bytes = 0;
+        bool paused = false;
+    };
+
     explicit Session(int fd);
     ~Session();
 
+    // Allocate a session together with its shared_ptr control block from
+    // the session slab pool instead of the global heap
+    static std::shared_ptr<Session> create(int fd);
+
     // Get file descriptor
     int getFd() const { return fd_; }
 
+    // Id of the reactor (EventLoop) that owns this connection
+    int getReactorId() const { return reactorId_; }
+    void setReactorId(int id) { reactorId_ = id; }
+
+    // Serial executor that runs this session's messages in order
+    StrandPtr getStrand() const { return strand_; }
+    void setStrand(StrandPtr strand) { strand_ = strand; }
+
+    // Serial executor on the dedicated pool, for DEDICATED handlers
+    StrandPtr getDedicatedStrand() const { return dedicatedStrand_; }
+    void setDedicatedStrand(StrandPtr strand) { dedicatedStrand_ = strand; }
+
     // Get packet buffer
     PacketBuffer& getBuffer() { return buffer_; }
 
+    FlowState& getFlowState() { return flow_; }
+
+    // Reads paused by backpressure: the reactor leaves the socket alone
+    // until resumed. Set on the reactor thread only.
+    bool isReadPaused() const { return readPaused_; }
+    void setReadPaused(bool paused);
+
     // Authentication state
     bool isAuthenticated() const { return authenticated_; }
     void setAuthenticated(bool auth) { authenticated_ = auth; }
 
-    // Username
-    const std::string& getUsername() const { return username_; }
-    void setUsername(const std::string& name) { username_ = name; }
+    // Username, readable from any thread
+    std::string getUsername() const {
+        std::lock_guard<std::mutex> lock(identityMutex_);
+        return std::string(username_);
+    }
+    void setUsername(const std::string& name);
 
     // Last heartbeat time
     std::chrono::steady_clock::time_point getLastHeartbeat() const { 
@@ -34,16 +87,94 @@ public:
         lastHeartbeat_ = std::chrono::steady_clock::now(); 
     }
 
-    // Send data
-    bool send(const char* data, size_t len);
-    bool sendMessage(const MessageHeader& header, const char* body = nullptr);
+    // Send data, never blocks: whatever the socket does not accept is
+    // appended to the outbound queue and flushed by the reactor.
+    // Header and body go out in one scatter-gather call.
+    // In coalescing mode everything is queued and flushed by the reactor
+    // once per loop iteration, batching all pending messages in one call.
+    // queuedBytes (optional) receives the number of bytes left queued.
+    // Messages leave in the order they were sent.
+    bool send(const char* data, size_t len, size_t* queuedBytes = nullptr);
+    bool sendMessage(const MessageHeader& header, const char* body = nullptr,
+                     size_t* queuedBytes = nullptr);
+
+    // Like sendMessage(), but queued ahead of other messages that have not
+    // started going out. Only for control frames no ordered reply depends
+    // on, such as heartbeat echoes.
+    bool sendUrgent(const MessageHeader& header, const char* body = nullptr,
+                    size_t* queuedBytes = nullptr);
+
+    // Send a pre-encoded frame shared with other sessions. Unsent bytes
+    // are queued by reference to the frame, never copied.
+    bool sendFrame(const BufferRef& frame, size_t len, size_t* queuedBytes = nullptr);
+
+    // Flush the outbound queue, called by the reactor when the fd is
+    // writable or a coalesced flush is due. Returns false on a socket error
+    bool flushOutput();
+
+    // Completion-based reactors (io_uring) hand the write to the kernel
+    // instead of calling flushOutput(). prepareAsyncWrite() describes the
+    // queue in iov and marks a write in flight, returning 0 when there is
+    // nothing to send or a write is already in flight. The queued bytes
+    // stay put until completeAsyncWrite() reports the result (bytes sent
+    // or -errno); it returns false on a socket error.
+    size_t prepareAsyncWrite(struct iovec* iov, size_t maxIov);
+    bool completeAsyncWrite(ssize_t result);
+
+    // Bytes waiting in the outbound queue
+    size_t getPendingOutputBytes() const;
+
+    // Set callback used to arm/disarm EPOLLIN and EPOLLOUT
+    void setInterestCallback(InterestCallback cb) {
+        interestCb_ = cb;
+    }
+
+    // Set callback used to schedule coalesced flushes
+    void setFlushRequestCallback(FlushRequestCallback cb) {
+        flushRequestCb_ = cb;
+    }
+
+    // Enable per-loop write coalescing
+    void setWriteCoalescing(bool enable) { coalesceWrites_ = enable; }
+
+    // Mark the connection closed, later sends fail instead of touching the fd
+    void markClosed();
+    bool isClosed() const;
 
 private:
+    bool sendLocked(const char* header, size_t headerLen,
+                    const char* body, size_t bodyLen, bool urgent);
+    bool sendFrameLocked(const BufferRef& frame, size_t len);
+    bool sendHeaderAndBody(const MessageHeader& header, const char* body,
+                           size_t* queuedBytes, bool urgent);
+    bool writeLocked();
+    void scheduleWriteLocked();
+    void armWriteLocked();
+
     int fd_;
+    int reactorId_;
+    StrandPtr strand_;
+    StrandPtr dedicatedStrand_;
     PacketBuffer buffer_;
-    bool authenticated_;
-    std::string username_;
+    FlowState flow_;
+    std::atomic<bool> authenticated_;
+    mutable std::mutex identityMutex_;
+    // Inline storage, login names are bounded by the protocol
+    char username_[sizeof(LoginRequest::username) + 1];
     std::chrono::steady_clock::time_point lastHeartbeat_;
+
+    // Outbound queue, guarded by sendMutex_
+    mutable std::mutex sendMutex_;
+    OutputQueue outQueue_;
+    bool writeArmed_;
+    bool flushScheduled_;
+    bool coalesceWrites_;
+    bool closed_;
+    bool asyncWriteInFlight_;  // kernel may still read the queued bytes
+    bool readPaused_;          // written under sendMutex_ by the reactor
+    int64_t stallStartNs_;   // when EPOLLOUT was last armed
+    InterestCallback interestCb_;
+    FlushRequestCallback flushRequestCb_;
 };
 
 using SessionPtr = std::shared_ptr<Session>;
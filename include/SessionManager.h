@@ -1,32 +1,71 @@
 #pragma once
 
 #include "Session.h"
-#include <map>
+#include "Executor.h"
+#include <array>
+#include <atomic>
+#include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <functional>
 #include <vector>
 
 namespace tcp_server {
 
+// What happens when a username logs in while already logged in elsewhere
+enum class DuplicateLoginPolicy {
+    REPLACE_EXISTING,  // the new login wins, the old session is kicked
+    REJECT_NEW         // the new login fails
+};
+
+// Outcome of a broadcast
+struct BroadcastResult {
+    size_t queued;   // sessions that took the frame (written or queued)
+    size_t dropped;  // sessions that could not take it (closed, queue full)
+    size_t slow;     // took it, but still have a large backlog to flush
+
+    BroadcastResult() : queued(0), dropped(0), slow(0) {}
+};
+
+// Session table split into lock-striped shards (by fd, and by username
+// for the username index). Single-session operations only lock one
+// shard; full iteration works on an immutable snapshot that is rebuilt
+// copy-on-write after sessions are added or removed.
 class SessionManager {
 public:
-    SessionManager() = default;
+    // Called with the session displaced by a REPLACE_EXISTING login
+    using SessionReplacedCallback = std::function<void(SessionPtr)>;
+
+    // Immutable list of all sessions at some point in time
+    using Snapshot = std::shared_ptr<const std::vector<SessionPtr>>;
+
+    explicit SessionManager(
+        DuplicateLoginPolicy policy = DuplicateLoginPolicy::REPLACE_EXISTING);
     ~SessionManager() = default;
 
     // Add a new session
     void addSession(SessionPtr session);
 
-    // Remove a session
-    void removeSession(int fd);
+    // Remove a session, a newer session on the same fd is left alone
+    void removeSession(const SessionPtr& session);
 
     // Get session by fd
     SessionPtr getSession(int fd);
 
+    // Get all sessions, cheap when nothing changed since the last call
+    Snapshot getSnapshot();
+
     // Get all authenticated sessions
     std::vector<SessionPtr> getAuthenticatedSessions();
 
-    // Broadcast message to all authenticated clients
-    void broadcast(const MessageHeader& header, const char* body = nullptr);
+    // Broadcast message to all authenticated clients. The frame is encoded
+    // once into a shared buffer and queued by reference on every session;
+    // large fan-outs are split into slices run on the fan-out executor.
+    BroadcastResult broadcast(const MessageHeader& header, const char* body = nullptr);
+
+    // Executor that helps with large broadcasts (optional)
+    void setFanoutExecutor(ExecutorPtr executor) { fanoutExecutor_ = executor; }
 
     // Send message to specific client by fd
     bool sendToClient(int fd, const MessageHeader& header, const char* body = nullptr);
@@ -34,15 +73,56 @@ public:
     // Send message to specific user by username
     bool sendToUser(const std::string& username, const MessageHeader& header, const char* body = nullptr);
 
-    // Get session by username
+    // Get session by username, O(1) through the username index
     SessionPtr getSessionByUsername(const std::string& username);
 
+    // Authenticate session as username and index it, applying the
+    // duplicate login policy. Returns false if the login is rejected.
+    bool bindUsername(SessionPtr session, const std::string& username);
+
+    // Duplicate login policy
+    DuplicateLoginPolicy getDuplicateLoginPolicy() const { return policy_; }
+    void setDuplicateLoginPolicy(DuplicateLoginPolicy policy) { policy_ = policy; }
+
+    void setSessionReplacedCallback(SessionReplacedCallback cb) {
+        sessionReplacedCb_ = cb;
+    }
+
     // Get session count
-    size_t getSessionCount() const;
+    size_t getSessionCount() const { return sessionCount_.load(); }
 
 private:
-    std::map<int, SessionPtr> sessions_;
-    mutable std::mutex mutex_;
+    static constexpr size_t SHARD_COUNT = 32;
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<int, SessionPtr> sessions;
+    };
+
+    struct alignas(64) UserShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, SessionPtr> sessions;
+    };
+
+    Shard& shardFor(int fd) { return shards_[static_cast<size_t>(fd) % SHARD_COUNT]; }
+    UserShard& userShardFor(const std::string& username) {
+        return userShards_[std::hash<std::string>()(username) % SHARD_COUNT];
+    }
+    void unindexUsername(const std::string& username, const SessionPtr& session);
+
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::array<UserShard, SHARD_COUNT> userShards_;
+    std::atomic<size_t> sessionCount_;
+
+    // Copy-on-write snapshot, rebuilt when version_ moved past snapshotVersion_
+    std::atomic<uint64_t> version_;
+    uint64_t snapshotVersion_;          // guarded by snapshotMutex_
+    Snapshot snapshot_;                 // accessed with std::atomic_load/store
+    std::mutex snapshotMutex_;          // serializes rebuilds only
+
+    DuplicateLoginPolicy policy_;
+    SessionReplacedCallback sessionReplacedCb_;
+    ExecutorPtr fanoutExecutor_;
 };
 
 using SessionManagerPtr = std::shared_ptr<SessionManager>;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Executor.h"
+#include "RingDeque.h"
+#include <memory>
+#include <mutex>
+
+namespace tcp_server {
+
+// Serial executor on top of a thread pool: tasks posted to one strand run
+// one at a time in FIFO order, while different strands run in parallel.
+// Only the strand's own mutex is taken, there is no global lock.
+// The strand is scheduled on the pool at the priority of its front task.
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+    explicit Strand(ExecutorPtr pool);
+    ~Strand() = default;
+
+    // Allocate a strand together with its shared_ptr control block from
+    // the strand slab pool instead of the global heap
+    static std::shared_ptr<Strand> create(ExecutorPtr pool);
+
+    // Queue a task behind the ones already posted to this strand
+    void post(Executor::Task task, Priority priority = Priority::NORMAL);
+
+    // Get pending task count
+    size_t getPendingTaskCount() const;
+
+private:
+    struct Entry {
+        Entry() : priority(Priority::NORMAL) {}
+        Entry(Executor::Task t, Priority p) : task(std::move(t)), priority(p) {}
+
+        Executor::Task task;
+        Priority priority;
+    };
+
+    void schedule(Priority priority);
+    void run(Priority priority);
+
+    ExecutorPtr pool_;
+    RingDeque<Entry> tasks_;
+    bool scheduled_;   // a run() is queued or executing on the pool
+    mutable std::mutex mutex_;
+};
+
+using StrandPtr = std::shared_ptr<Strand>;
+
+} // namespace tcp_server
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace tcp_server {
+
+// Slab of fixed-size chunks for closures too large for Task's inline
+// storage. Chunks are recycled, so steady-state submissions do not malloc.
+class TaskSlab {
+public:
+    static constexpr size_t CHUNK_SIZE = 512;
+
+    // Objects larger than CHUNK_SIZE fall back to operator new
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+};
+
+// Move-only type-erased void() callable with inline storage.
+// Closures up to INLINE_CAPACITY bytes are stored in place (no heap
+// allocation), larger ones in a TaskSlab chunk.
+class Task {
+public:
+    static constexpr size_t INLINE_CAPACITY = 96;
+
+    Task() : ops_(nullptr), heap_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : ops_(nullptr), heap_(nullptr) {
+        using Fn = typename std::decay<F>::type;
+        if (fitsInline<Fn>()) {
+            new (&storage_) Fn(std::forward<F>(f));
+        } else {
+            heap_ = TaskSlab::allocate(sizeof(Fn));
+            new (heap_) Fn(std::forward<F>(f));
+        }
+        ops_ = &OpsFor<Fn>::ops;
+    }
+
+    Task(Task&& other) noexcept : ops_(nullptr), heap_(nullptr) {
+        moveFrom(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(target()); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(target(), heap_ != nullptr);
+            ops_ = nullptr;
+            heap_ = nullptr;
+        }
+    }
+
+private:
+    using Storage = std::aligned_storage<INLINE_CAPACITY, alignof(std::max_align_t)>::type;
+
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);     // inline storage only
+        void (*destroy)(void*, bool onHeap);
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= INLINE_CAPACITY &&
+               alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <typename Fn>
+    struct OpsFor {
+        static void invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        static void move(void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void destroy(void* p, bool onHeap) {
+            static_cast<Fn*>(p)->~Fn();
+            if (onHeap) {
+                TaskSlab::deallocate(p, sizeof(Fn));
+            }
+        }
+        static const Ops ops;
+    };
+
+    void* target() { return heap_ ? heap_ : static_cast<void*>(&storage_); }
+
+    void moveFrom(Task& other) {
+        if (!other.ops_) {
+            return;
+        }
+        ops_ = other.ops_;
+        if (other.heap_) {
+            // Heap closures just change owner
+            heap_ = other.heap_;
+        } else {
+            ops_->move(&storage_, &other.storage_);
+        }
+        other.ops_ = nullptr;
+        other.heap_ = nullptr;
+    }
+
+    Storage storage_;
+    const Ops* ops_;
+    void* heap_;
+};
+
+template <typename Fn>
+const Task::Ops Task::OpsFor<Fn>::ops = {
+    &Task::OpsFor<Fn>::invoke,
+    &Task::OpsFor<Fn>::move,
+    &Task::OpsFor<Fn>::destroy
+};
+
+} // namespace tcp_server
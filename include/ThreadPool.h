@@ -1,37 +1,44 @@
 #pragma once
 
+#include "Executor.h"
+#include "PriorityTaskQueue.h"
+#include "Metrics.h"
 #include <vector>
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
 #include <atomic>
 #include <memory>
 
 namespace tcp_server {
 
-class ThreadPool {
+// Thread pool with a single task queue shared by all workers, one FIFO
+// per priority class
+class ThreadPool : public Executor {
 public:
-    using Task = std::function<void()>;
-
     explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
-    ~ThreadPool();
+    // Uses threadCount and firstCpu
+    explicit ThreadPool(const ExecutorConfig& config);
+    ~ThreadPool() override;
+
+    using Executor::submit;
 
     // Submit a task to the thread pool
-    void submit(Task task);
+    void submit(Task task, Priority priority) override;
 
     // Get number of threads
-    size_t getThreadCount() const { return threads_.size(); }
+    size_t getThreadCount() const override { return threads_.size(); }
 
     // Get pending task count
-    size_t getPendingTaskCount() const;
+    size_t getPendingTaskCount() const override;
 
 private:
     void workerThread();
 
     std::vector<std::thread> threads_;
-    std::queue<Task> tasks_;
+    PriorityTaskQueue tasks_;
+    Histogram* queueWait_;
+    Histogram* const* queueWaitByPriority_;
     
     mutable std::mutex mutex_;
     std::condition_variable condition_;
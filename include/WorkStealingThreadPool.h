@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Executor.h"
+#include "MpmcQueue.h"
+#include "RingDeque.h"
+#include "PriorityTaskQueue.h"
+#include "Metrics.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+namespace tcp_server {
+
+// Thread pool where every worker owns a deque. Tasks submitted by a
+// worker stay on its own deque, tasks from other threads (the reactors)
+// go through a lock-free injection queue, and idle workers steal from
+// the others' deques. HIGH and LOW tasks skip the deques and wait in
+// one shared queue per class, checked before and after the NORMAL ones.
+class WorkStealingThreadPool : public Executor {
+public:
+    explicit WorkStealingThreadPool(
+        size_t threadCount = std::thread::hardware_concurrency());
+    // Uses threadCount, firstCpu and injectionQueueCapacity
+    explicit WorkStealingThreadPool(const ExecutorConfig& config);
+    ~WorkStealingThreadPool() override;
+
+    using Executor::submit;
+
+    // Submit a task to the thread pool
+    void submit(Task task, Priority priority) override;
+
+    // Get number of threads
+    size_t getThreadCount() const override { return workers_.size(); }
+
+    // Get pending task count
+    size_t getPendingTaskCount() const override { return pending_.load(); }
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;         // only contended by thieves
+        RingDeque<QueuedTask> tasks;
+        // Owner only: picks that passed over waiting NORMAL / LOW work,
+        // and all picks
+        size_t normalSkips = 0;
+        size_t lowSkips = 0;
+        size_t picks = 0;
+    };
+
+    void workerThread(size_t index);
+    bool popNext(size_t index, QueuedTask& task);
+    bool popRanked(Priority priority, QueuedTask& task);
+    bool popLocal(size_t index, QueuedTask& task);
+    bool popInjected(QueuedTask& task);
+    bool steal(size_t index, QueuedTask& task);
+    void notifyIdleWorker();
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // Injection queue for tasks submitted from outside the pool, with a
+    // locked overflow list for when the ring is full
+    MpmcQueue<QueuedTask> injected_;
+    std::mutex overflowMutex_;
+    RingDeque<QueuedTask> overflow_;
+    std::atomic<size_t> overflowSize_;
+
+    // HIGH and LOW tasks, counts per class readable without the lock
+    std::mutex rankedMutex_;
+    PriorityTaskQueue ranked_;
+    std::atomic<size_t> rankedCounts_[PRIORITY_COUNT];
+
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> sleepers_;
+    std::mutex idleMutex_;
+    std::condition_variable idleCondition_;
+    std::atomic<bool> stopped_;
+    Histogram* queueWait_;
+    Histogram* const* queueWaitByPriority_;
+};
+
+} // namespace tcp_server
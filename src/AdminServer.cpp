@@ -0,0 +1,157 @@
+#include "AdminServer.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "Logger.h"
+
+namespace tcp_server {
+
+// How often the serving thread checks whether it should stop
+constexpr int ADMIN_POLL_MS = 200;
+
+AdminServer::AdminServer(const std::string& path, ContentCallback callback)
+    : path_(path)
+    , callback_(std::move(callback))
+    , listenFd_(-1)
+    , running_(false) {
+}
+
+AdminServer::~AdminServer() {
+    stop();
+}
+
+std::string AdminServer::defaultPath(int port) {
+    std::string name = "/tcp_server_" + std::to_string(port) + ".sock";
+
+    const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && runtimeDir[0] == '/') {
+        return runtimeDir + name;
+    }
+
+    // /tmp is shared: use a directory only this user can enter, so nobody
+    // else can pre-create or swap the socket path
+    std::string dir = "/tmp/tcp_server-" + std::to_string(geteuid());
+    if (::mkdir(dir.c_str(), S_IRWXU) < 0 && errno != EEXIST) {
+        LOG_ERROR << "Failed to create admin socket directory " << dir << ": "
+                  << strerror(errno);
+        return std::string();
+    }
+
+    struct stat st;
+    if (::lstat(dir.c_str(), &st) < 0 || !S_ISDIR(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        LOG_ERROR << "Admin socket directory " << dir
+                  << " is not a private directory owned by this user";
+        return std::string();
+    }
+    return dir + name;
+}
+
+bool AdminServer::start() {
+    if (running_) {
+        return true;
+    }
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR << "Admin socket path too long: " << path_;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path_.c_str(), path_.size());
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        LOG_ERROR << "Failed to create admin socket: " << strerror(errno);
+        return false;
+    }
+
+    // A stale socket file from a previous run would make bind fail
+    ::unlink(path_.c_str());
+
+    // Metrics are for the local operator only. The socket file takes its
+    // mode from the umask at bind time, so there is no window in which
+    // other users could connect before a chmod.
+    mode_t oldMask = ::umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    int rc = bind(listenFd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    int bindErrno = errno;
+    ::umask(oldMask);
+
+    if (rc < 0) {
+        LOG_ERROR << "Failed to bind admin socket " << path_ << ": " << strerror(bindErrno);
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    if (listen(listenFd_, 8) < 0) {
+        LOG_ERROR << "Failed to listen on admin socket: " << strerror(errno);
+        close(listenFd_);
+        listenFd_ = -1;
+        ::unlink(path_.c_str());
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { serveLoop(); });
+
+    LOG_INFO << "Admin socket listening on " << path_;
+    return true;
+}
+
+void AdminServer::stop() {
+    if (!running_) {
+        return;
+    }
+
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    close(listenFd_);
+    listenFd_ = -1;
+    ::unlink(path_.c_str());
+}
+
+void AdminServer::serveLoop() {
+    while (running_) {
+        struct pollfd pfd;
+        pfd.fd = listenFd_;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int ready = poll(&pfd, 1, ADMIN_POLL_MS);
+        if (ready <= 0) {
+            continue;
+        }
+
+        int clientFd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientFd < 0) {
+            continue;
+        }
+
+        std::string content = callback_ ? callback_() : std::string();
+        size_t sent = 0;
+        while (sent < content.size()) {
+            ssize_t n = ::send(clientFd, content.data() + sent, 
+                               content.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            sent += n;
+        }
+        close(clientFd);
+    }
+}
+
+} // namespace tcp_server
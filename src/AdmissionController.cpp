@@ -0,0 +1,89 @@
+#include "AdmissionController.h"
+#include "Logger.h"
+
+namespace tcp_server {
+
+AdmissionController::AdmissionController(const Histogram* queueWait)
+    : queueWait_(queueWait)
+    , nextRefreshNs_(0)
+    , overloaded_(false)
+    , windowP99_(0)
+    , lastBuckets_(HISTOGRAM_BUCKETS, 0)
+    , buckets_(HISTOGRAM_BUCKETS, 0) {
+}
+
+AdmissionAction AdmissionController::admit() const {
+    if (config_.queueWaitP99LimitNs <= 0) {
+        return AdmissionAction::ADMIT;
+    }
+    return overloaded_.load(std::memory_order_relaxed) ? config_.overloadAction
+                                                       : AdmissionAction::ADMIT;
+}
+
+void AdmissionController::refresh(int64_t nowNs) {
+    if (config_.queueWaitP99LimitNs <= 0 ||
+        nowNs < nextRefreshNs_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // One thread recomputes, the others keep the current decision
+    std::unique_lock<std::mutex> lock(refreshMutex_, std::try_to_lock);
+    if (!lock.owns_lock() || nowNs < nextRefreshNs_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    uint64_t p99 = rollWindow(nowNs);
+    uint64_t limit = static_cast<uint64_t>(config_.queueWaitP99LimitNs);
+    bool wasOverloaded = overloaded_.load(std::memory_order_relaxed);
+    if (!wasOverloaded && p99 > limit) {
+        overloaded_.store(true);
+        LOG_DEBUG << "Queue wait p99 " << p99 << "ns above " << limit
+                  << "ns, shedding sheddable messages";
+    } else if (wasOverloaded && p99 <= limit / 2) {
+        endOverload(lock, p99);
+    }
+}
+
+void AdmissionController::onQueueDrained(int64_t nowNs) {
+    if (!overloaded_.load()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(refreshMutex_);
+    if (!overloaded_.load()) {
+        return;
+    }
+    // The drained tail would keep the next window above the limit
+    rollWindow(nowNs);
+    windowP99_.store(0, std::memory_order_relaxed);
+    endOverload(lock, 0);
+}
+
+uint64_t AdmissionController::rollWindow(int64_t nowNs) {
+    nextRefreshNs_.store(nowNs + config_.windowNs, std::memory_order_relaxed);
+
+    // Only what was recorded since the last window counts
+    queueWait_->mergeBuckets(buckets_.data());
+    uint64_t count = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        uint64_t current = buckets_[i];
+        buckets_[i] = current - lastBuckets_[i];
+        lastBuckets_[i] = current;
+        count += buckets_[i];
+    }
+
+    uint64_t p99 = Histogram::percentileOf(buckets_.data(), count, 0.99);
+    windowP99_.store(p99, std::memory_order_relaxed);
+    return p99;
+}
+
+void AdmissionController::endOverload(std::unique_lock<std::mutex>& lock, uint64_t p99) {
+    overloaded_.store(false);
+    LOG_DEBUG << "Queue wait p99 " << p99 << "ns, admitting all messages";
+    lock.unlock();
+    if (overloadEndedCb_) {
+        overloadEndedCb_();
+    }
+}
+
+} // namespace tcp_server
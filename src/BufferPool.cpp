@@ -0,0 +1,231 @@
+#include "BufferPool.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include "Logger.h"
+
+namespace tcp_server {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Classes carved from huge page arenas, bigger ones do not pack well
+// into 2 MB and come from the heap
+constexpr size_t ARENA_MAX_BLOCK_SIZE = HUGE_PAGE_SIZE / 8;
+
+// Arena blocks start on cache line boundaries
+constexpr size_t ARENA_BLOCK_ALIGN = 64;
+
+namespace {
+
+std::atomic<bool> defaultHugePages(false);
+
+// 2 MB of memory on a 2 MB boundary, preferring reserved huge pages and
+// falling back to transparent ones. nullptr if nothing could be mapped.
+void* mapHugeRegion() {
+    void* p = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+
+    // Over-map so the region can be trimmed to an aligned 2 MB
+    size_t span = HUGE_PAGE_SIZE * 2;
+    p = mmap(nullptr, span, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (aligned > start) {
+        munmap(p, aligned - start);
+    }
+    size_t tail = start + span - (aligned + HUGE_PAGE_SIZE);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + HUGE_PAGE_SIZE), tail);
+    }
+
+    void* region = reinterpret_cast<void*>(aligned);
+    madvise(region, HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+    return region;
+}
+
+} // namespace
+
+BufferPool::BufferPool(size_t maxFreeBytesPerClass, bool hugePages)
+    : hugePages_(hugePages)
+    , oversizeAcquires_(0)
+    , oversizeLive_(0) {
+    size_t blockSize = BUFFER_MIN_CLASS_SIZE;
+    for (size_t i = 0; i < BUFFER_SIZE_CLASSES; ++i) {
+        classes_[i].blockSize = blockSize;
+        // Keep a few blocks of even the largest class
+        classes_[i].maxFreeBlocks = std::max<size_t>(maxFreeBytesPerClass / blockSize, 4);
+        blockSize *= 4;
+    }
+}
+
+BufferPool::~BufferPool() {
+    for (auto& cls : classes_) {
+        for (BufferBlock* block : cls.freeBlocks) {
+            if (block->origin_ != BufferBlock::ARENA) {
+                freeBlock(block);
+            }
+        }
+    }
+
+    for (auto& arena : arenas_) {
+        munmap(arena.first, arena.second);
+    }
+}
+
+BufferPool& BufferPool::defaultPool() {
+    // Intentionally leaked, blocks may be released during static destruction
+    static BufferPool* pool = new BufferPool(32 * 1024 * 1024, defaultHugePages.load());
+    return *pool;
+}
+
+void BufferPool::setDefaultHugePages(bool enable) {
+    defaultHugePages = enable;
+}
+
+size_t BufferPool::classIndex(size_t minSize) {
+    size_t index = 0;
+    size_t blockSize = BUFFER_MIN_CLASS_SIZE;
+    while (blockSize < minSize && index < BUFFER_SIZE_CLASSES) {
+        blockSize *= 4;
+        ++index;
+    }
+    return index;
+}
+
+size_t BufferPool::roundUp(size_t minSize) {
+    size_t index = classIndex(minSize);
+    if (index == BUFFER_SIZE_CLASSES) {
+        return minSize;
+    }
+    return BUFFER_MIN_CLASS_SIZE << (2 * index);
+}
+
+BufferRef BufferPool::acquire(size_t minSize) {
+    size_t index = classIndex(minSize);
+    if (index == BUFFER_SIZE_CLASSES) {
+        oversizeAcquires_.fetch_add(1, std::memory_order_relaxed);
+        oversizeLive_.fetch_add(1, std::memory_order_relaxed);
+        return BufferRef(allocateBlock(minSize, index));
+    }
+
+    SizeClass& cls = classes_[index];
+    cls.acquires.fetch_add(1, std::memory_order_relaxed);
+    cls.live.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(cls.mutex);
+        if (cls.freeBlocks.empty() && hugePages_ && cls.blockSize <= ARENA_MAX_BLOCK_SIZE) {
+            refillFromArena(cls, index);
+        }
+        if (!cls.freeBlocks.empty()) {
+            BufferBlock* block = cls.freeBlocks.back();
+            cls.freeBlocks.pop_back();
+            block->refCount_.store(1, std::memory_order_relaxed);
+            return BufferRef(block);
+        }
+    }
+
+    cls.misses.fetch_add(1, std::memory_order_relaxed);
+    return BufferRef(allocateBlock(cls.blockSize, index));
+}
+
+void BufferPool::refillFromArena(SizeClass& cls, size_t sizeClass) {
+    void* region = mapHugeRegion();
+    if (!region) {
+        LOG_WARN << "Buffer pool: failed to map a huge page arena, using the heap";
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(arenaMutex_);
+        arenas_.emplace_back(region, HUGE_PAGE_SIZE);
+    }
+
+    size_t stride = (sizeof(BufferBlock) + cls.blockSize + ARENA_BLOCK_ALIGN - 1) &
+                    ~(ARENA_BLOCK_ALIGN - 1);
+    char* base = static_cast<char*>(region);
+    for (size_t offset = 0; offset + stride <= HUGE_PAGE_SIZE; offset += stride) {
+        cls.freeBlocks.push_back(new (base + offset) BufferBlock(
+            this, cls.blockSize, static_cast<uint8_t>(sizeClass), BufferBlock::ARENA));
+    }
+    cls.misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t BufferPool::getFreeBlockCount() const {
+    size_t total = 0;
+    for (auto& cls : classes_) {
+        std::lock_guard<std::mutex> lock(cls.mutex);
+        total += cls.freeBlocks.size();
+    }
+    return total;
+}
+
+std::vector<BufferPoolStats> BufferPool::getStats() const {
+    std::vector<BufferPoolStats> stats;
+    stats.reserve(BUFFER_SIZE_CLASSES + 1);
+
+    for (auto& cls : classes_) {
+        BufferPoolStats row;
+        row.blockSize = cls.blockSize;
+        {
+            std::lock_guard<std::mutex> lock(cls.mutex);
+            row.freeBlocks = cls.freeBlocks.size();
+        }
+        row.liveBlocks = static_cast<size_t>(
+            std::max<int64_t>(cls.live.load(std::memory_order_relaxed), 0));
+        row.acquires = cls.acquires.load(std::memory_order_relaxed);
+        row.misses = cls.misses.load(std::memory_order_relaxed);
+        stats.push_back(row);
+    }
+
+    // Oversize blocks are never cached, every acquire allocates
+    BufferPoolStats oversize;
+    oversize.liveBlocks = static_cast<size_t>(
+        std::max<int64_t>(oversizeLive_.load(std::memory_order_relaxed), 0));
+    oversize.acquires = oversizeAcquires_.load(std::memory_order_relaxed);
+    oversize.misses = oversize.acquires;
+    stats.push_back(oversize);
+
+    return stats;
+}
+
+BufferBlock* BufferPool::allocateBlock(size_t capacity, size_t sizeClass) {
+    void* memory = ::operator new(sizeof(BufferBlock) + capacity);
+    return new (memory) BufferBlock(this, capacity, static_cast<uint8_t>(sizeClass),
+                                    BufferBlock::HEAP);
+}
+
+void BufferPool::recycle(BufferBlock* block) {
+    if (block->sizeClass_ < BUFFER_SIZE_CLASSES) {
+        SizeClass& cls = classes_[block->sizeClass_];
+        cls.live.fetch_sub(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(cls.mutex);
+        // Arena blocks cannot be freed one by one, always keep them
+        if (block->origin_ == BufferBlock::ARENA ||
+            cls.freeBlocks.size() < cls.maxFreeBlocks) {
+            cls.freeBlocks.push_back(block);
+            return;
+        }
+    } else {
+        oversizeLive_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    freeBlock(block);
+}
+
+void BufferPool::freeBlock(BufferBlock* block) {
+    block->~BufferBlock();
+    ::operator delete(block);
+}
+
+} // namespace tcp_server
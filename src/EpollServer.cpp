@@ -1,23 +1,53 @@
 #include "EpollServer.h"
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstring>
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
 
 namespace tcp_server {
 
-constexpr int MAX_EVENTS = 1024;
-constexpr int BACKLOG = 128;
-
-EpollServer::EpollServer(int port)
-    : port_(port)
+// Per-epoll busy polling (Linux 6.9), missing from older headers
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+// Packets processed per busy poll round
+constexpr uint16_t BUSY_POLL_BUDGET = 64;
+
+EpollServer::EpollServer(const EventLoopConfig& config, int id, bool reusePort)
+    : config_(config)
+    , id_(id)
+    , reusePort_(reusePort)
     , listenFd_(-1)
     , epollFd_(-1)
+    , wakeupFd_(-1)
     , running_(false) {
+    if (config_.maxEvents <= 0) {
+        config_.maxEvents = 1;
+    }
+    if (config_.recvChunkBytes == 0) {
+        config_.recvChunkBytes = 1;
+    }
+    setReadBudget(config_.readBudgetBytes, config_.readBudgetMessages);
+    events_.resize(config_.maxEvents);
+}
+
+void EpollServer::setReadBudget(size_t bytes, size_t messages) {
+    config_.readBudgetBytes = bytes > 0 ? bytes : 1;
+    config_.readBudgetMessages = messages > 0 ? messages : 1;
 }
 
 EpollServer::~EpollServer() {
@@ -25,59 +55,35 @@ EpollServer::~EpollServer() {
 }
 
 bool EpollServer::createListenSocket() {
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    listenFd_ = openListenSocket(config_, reusePort_);
     if (listenFd_ < 0) {
-        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
-        return false;
-    }
-
-    // Set SO_REUSEADDR
-    int opt = 1;
-    if (setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
-        close(listenFd_);
-        return false;
-    }
-
-    // Bind
-    struct sockaddr_in addr;
-    std::memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port_);
-
-    if (bind(listenFd_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        std::cerr << "Failed to bind: " << strerror(errno) << std::endl;
-        close(listenFd_);
         return false;
     }
 
-    // Listen
-    if (listen(listenFd_, BACKLOG) < 0) {
-        std::cerr << "Failed to listen: " << strerror(errno) << std::endl;
-        close(listenFd_);
-        return false;
-    }
+    LOG_INFO << "Listening on port " << config_.port << ", reactor=" << id_;
+    return true;
+}
 
-    // Set non-blocking
-    if (!setNonBlocking(listenFd_)) {
-        close(listenFd_);
-        return false;
+void EpollServer::enableBusyPoll() {
+    struct epoll_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.busy_poll_usecs = static_cast<uint32_t>(config_.busyPollUs);
+    params.busy_poll_budget = BUSY_POLL_BUDGET;
+    params.prefer_busy_poll = 1;
+    if (ioctl(epollFd_, EPIOCSPARAMS, &params) < 0) {
+        LOG_WARN << "Failed to enable epoll busy polling: " << strerror(errno);
     }
-
-    std::cout << "Listening on port " << port_ << std::endl;
-    return true;
 }
 
 bool EpollServer::setNonBlocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags < 0) {
-        std::cerr << "Failed to get flags: " << strerror(errno) << std::endl;
+        LOG_ERROR << "Failed to get flags: " << strerror(errno);
         return false;
     }
 
     if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-        std::cerr << "Failed to set non-blocking: " << strerror(errno) << std::endl;
+        LOG_ERROR << "Failed to set non-blocking: " << strerror(errno);
         return false;
     }
 
@@ -96,25 +102,49 @@ bool EpollServer::start() {
     // Create epoll
     epollFd_ = epoll_create1(0);
     if (epollFd_ < 0) {
-        std::cerr << "Failed to create epoll: " << strerror(errno) << std::endl;
+        LOG_ERROR << "Failed to create epoll: " << strerror(errno);
         close(listenFd_);
         return false;
     }
 
+    if (config_.busyPollUs > 0) {
+        enableBusyPoll();
+    }
+
     // Add listen socket to epoll
     struct epoll_event ev;
     ev.events = EPOLLIN;
     ev.data.fd = listenFd_;
     if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev) < 0) {
-        std::cerr << "Failed to add listen socket to epoll: " 
-                  << strerror(errno) << std::endl;
+        LOG_ERROR << "Failed to add listen socket to epoll: " 
+                  << strerror(errno);
+        close(epollFd_);
+        close(listenFd_);
+        return false;
+    }
+
+    // Create wakeup eventfd so other threads can interrupt epoll_wait
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupFd_ < 0) {
+        LOG_ERROR << "Failed to create eventfd: " << strerror(errno);
+        close(epollFd_);
+        close(listenFd_);
+        return false;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeupFd_;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeupFd_, &ev) < 0) {
+        LOG_ERROR << "Failed to add eventfd to epoll: " 
+                  << strerror(errno);
+        close(wakeupFd_);
         close(epollFd_);
         close(listenFd_);
         return false;
     }
 
     running_ = true;
-    std::cout << "Server started successfully" << std::endl;
+    LOG_INFO << "Server started successfully";
     return true;
 }
 
@@ -127,10 +157,16 @@ void EpollServer::stop() {
 
     // Close all client connections
     for (auto& pair : sessions_) {
+        pair.second->markClosed();
         close(pair.first);
     }
     sessions_.clear();
 
+    if (wakeupFd_ >= 0) {
+        close(wakeupFd_);
+        wakeupFd_ = -1;
+    }
+
     if (epollFd_ >= 0) {
         close(epollFd_);
         epollFd_ = -1;
@@ -141,7 +177,7 @@ void EpollServer::stop() {
         listenFd_ = -1;
     }
 
-    std::cout << "Server stopped" << std::endl;
+    LOG_INFO << "Server stopped";
 }
 
 void EpollServer::runOnce(int timeoutMs) {
@@ -149,14 +185,19 @@ void EpollServer::runOnce(int timeoutMs) {
         return;
     }
 
-    struct epoll_event events[MAX_EVENTS];
-    int nfds = epoll_wait(epollFd_, events, MAX_EVENTS, timeoutMs);
+    LoopScope scope(this);
+
+    // Connections left on the ready list still have data, only pick up
+    // new events instead of blocking
+    struct epoll_event* events = events_.data();
+    int nfds = epoll_wait(epollFd_, events, config_.maxEvents,
+                          readyList_.empty() ? timeoutMs : 0);
 
     if (nfds < 0) {
         if (errno == EINTR) {
             return;
         }
-        std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
+        LOG_ERROR << "epoll_wait error: " << strerror(errno);
         return;
     }
 
@@ -166,14 +207,110 @@ void EpollServer::runOnce(int timeoutMs) {
         if (fd == listenFd_) {
             // New connection
             handleNewConnection();
+        } else if (fd == wakeupFd_) {
+            // Woken up by another thread
+            handleWakeup();
         } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
             // Error or hangup
             handleClientDisconnect(fd);
-        } else if (events[i].events & EPOLLIN) {
-            // Data available
-            handleClientData(fd);
+        } else {
+            if ((events[i].events & EPOLLIN) && handleClientData(fd)) {
+                // Out of budget, finish on the ready list
+                markReady(fd);
+            }
+            if (events[i].events & EPOLLOUT) {
+                // Socket writable, flush queued output
+                handleClientWrite(fd);
+            }
         }
     }
+
+    serviceReadyList();
+    doPendingFunctors();
+    doPendingFlushes();
+}
+
+void EpollServer::markReady(int fd) {
+    if (readySet_.insert(fd).second) {
+        readyList_.push_back(fd);
+    }
+}
+
+void EpollServer::serviceReadyList() {
+    // One more budget for each connection that was waiting; those that
+    // run out again go to the back, behind the next batch of events
+    std::vector<int> ready;
+    ready.swap(readyList_);
+    readySet_.clear();
+
+    for (int fd : ready) {
+        if (handleClientData(fd)) {
+            markReady(fd);
+        }
+    }
+}
+
+void EpollServer::queueInLoop(Functor functor) {
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        pendingFunctors_.push_back(std::move(functor));
+    }
+    wakeup();
+}
+
+void EpollServer::wakeup() {
+    if (wakeupFd_ < 0) {
+        return;
+    }
+
+    uint64_t one = 1;
+    ssize_t n = write(wakeupFd_, &one, sizeof(one));
+    (void)n;
+}
+
+void EpollServer::requestFlush(int fd) {
+    bool needWakeup;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        needWakeup = pendingFlushes_.empty();
+        pendingFlushes_.push_back(fd);
+    }
+
+    // Sends from the loop thread itself (inline handlers) are flushed at
+    // the end of this iteration, no need to interrupt the next wait
+    if (needWakeup && !isInLoopThread()) {
+        wakeup();
+    }
+}
+
+void EpollServer::doPendingFlushes() {
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        fds.swap(pendingFlushes_);
+    }
+
+    for (int fd : fds) {
+        handleClientWrite(fd);
+    }
+}
+
+void EpollServer::handleWakeup() {
+    uint64_t value;
+    ssize_t n = read(wakeupFd_, &value, sizeof(value));
+    (void)n;
+}
+
+void EpollServer::doPendingFunctors() {
+    std::vector<Functor> functors;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        functors.swap(pendingFunctors_);
+    }
+
+    for (auto& functor : functors) {
+        functor();
+    }
 }
 
 void EpollServer::handleNewConnection() {
@@ -186,7 +323,7 @@ void EpollServer::handleNewConnection() {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
             }
-            std::cerr << "Accept error: " << strerror(errno) << std::endl;
+            LOG_ERROR << "Accept error: " << strerror(errno);
             break;
         }
 
@@ -201,21 +338,29 @@ void EpollServer::handleNewConnection() {
         ev.events = EPOLLIN | EPOLLET;  // Edge-triggered
         ev.data.fd = clientFd;
         if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientFd, &ev) < 0) {
-            std::cerr << "Failed to add client to epoll: " 
-                      << strerror(errno) << std::endl;
+            LOG_ERROR << "Failed to add client to epoll: " 
+                      << strerror(errno);
             close(clientFd);
             continue;
         }
 
         // Create session
-        auto session = std::make_shared<Session>(clientFd);
+        auto session = Session::create(clientFd);
+        session->setReactorId(id_);
+        session->setInterestCallback(
+            [this](int fd, bool readable, bool writable) {
+                updateEvents(fd, readable, writable);
+            });
+        session->setFlushRequestCallback(
+            [this](int fd) { requestFlush(fd); });
+        session->setWriteCoalescing(config_.writeCoalescing);
         sessions_[clientFd] = session;
 
         char ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &clientAddr.sin_addr, ip, sizeof(ip));
-        std::cout << "New connection from " << ip << ":" 
-                  << ntohs(clientAddr.sin_port) 
-                  << ", fd=" << clientFd << std::endl;
+        LOG_INFO << "New connection from " << ip << ":" 
+                 << ntohs(clientAddr.sin_port) 
+                 << ", fd=" << clientFd;
 
         if (newConnectionCb_) {
             newConnectionCb_(session);
@@ -223,78 +368,170 @@ void EpollServer::handleNewConnection() {
     }
 }
 
-void EpollServer::handleClientData(int fd) {
+bool EpollServer::handleClientData(int fd) {
     auto it = sessions_.find(fd);
     if (it == sessions_.end()) {
-        return;
+        return false;
     }
 
     auto session = it->second;
-    char buffer[4096];
+    PacketBuffer& packetBuffer = session->getBuffer();
+    size_t messageBudget = config_.readBudgetMessages;
+    size_t bytesRead = 0;
 
-    while (true) {
-        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    // Messages left over from the previous round go first
+    if (!deliverMessages(session, messageBudget)) {
+        return true;
+    }
+
+    // Backpressure: leave the data in the socket, resumeReading() re-arms
+    // EPOLLIN and the kernel reports it again
+    while (!session->isReadPaused()) {
+        if (bytesRead >= config_.readBudgetBytes) {
+            return true;
+        }
+
+        // Receive straight into the packet buffer's free space
+        packetBuffer.ensureWritable(config_.recvChunkBytes);
+        ssize_t n = recv(fd, packetBuffer.writeBegin(), 
+                         packetBuffer.writableBytes(), 0);
         
         if (n < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
             }
-            std::cerr << "Recv error: " << strerror(errno) << std::endl;
+            LOG_ERROR << "Recv error: " << strerror(errno);
             handleClientDisconnect(fd);
-            return;
+            return false;
         } else if (n == 0) {
             // Connection closed
             handleClientDisconnect(fd);
-            return;
+            return false;
         }
 
-        // Append to buffer
-        session->getBuffer().append(buffer, n);
+        packetBuffer.hasWritten(n);
+        bytesRead += static_cast<size_t>(n);
+        ServerMetrics::get().bytesIn->add(n);
 
-        // Try to extract messages
-        MessageHeader header;
-        std::vector<char> body;
-        while (session->getBuffer().extractMessage(header, body)) {
-            if (messageCb_) {
-                messageCb_(session, header, body);
-            }
+        if (!deliverMessages(session, messageBudget)) {
+            return true;
         }
     }
+    return false;
 }
 
-void EpollServer::closeConnection(int fd) {
-    if (!running_) {
-        return;
+bool EpollServer::deliverMessages(const SessionPtr& session, size_t& budget) {
+    // Complete messages beyond a pause stay in the buffer until resumed
+    PacketBuffer& packetBuffer = session->getBuffer();
+    int64_t arrivalNs = 0;
+    while (!session->isReadPaused()) {
+        if (budget == 0) {
+            return false;
+        }
+        Message message;
+        if (!packetBuffer.extractMessage(message)) {
+            break;
+        }
+        --budget;
+        // One clock read covers the whole batch
+        if (arrivalNs == 0) {
+            arrivalNs = metricsNowNs();
+        }
+        message.setArrivalNs(arrivalNs);
+        if (messageCb_) {
+            messageCb_(session, message);
+        }
     }
+    return true;
+}
 
+void EpollServer::handleClientWrite(int fd) {
     auto it = sessions_.find(fd);
     if (it == sessions_.end()) {
         return;
     }
 
-    std::cout << "Closing connection, fd=" << fd << std::endl;
-    handleClientDisconnect(fd);
+    if (!it->second->flushOutput()) {
+        handleClientDisconnect(fd);
+    }
+}
+
+void EpollServer::pauseReading(const SessionPtr& session) {
+    session->setReadPaused(true);
+}
+
+void EpollServer::resumeReading(const SessionPtr& session) {
+    // The fd may belong to a newer connection by now
+    auto it = sessions_.find(session->getFd());
+    if (it == sessions_.end() || it->second != session) {
+        return;
+    }
+    session->setReadPaused(false);
+    // Messages held back while paused are delivered from the ready list
+    markReady(session->getFd());
+}
+
+void EpollServer::updateEvents(int fd, bool readable, bool writable) {
+    // epoll_ctl is thread-safe, so sessions may call this from worker threads.
+    // Re-adding EPOLLIN reports data that arrived while reads were paused.
+    struct epoll_event ev;
+    ev.events = EPOLLET;
+    if (readable) {
+        ev.events |= EPOLLIN;
+    }
+    if (writable) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        LOG_ERROR << "Failed to modify epoll events, fd=" << fd << ": "
+                  << strerror(errno);
+    }
+}
+
+void EpollServer::closeConnection(const SessionPtr& session) {
+    if (!running_) {
+        return;
+    }
+
+    // The session table is owned by the loop thread, so defer the close to it.
+    // The fd may belong to a newer connection by the time the functor runs.
+    queueInLoop([this, session]() {
+        int fd = session->getFd();
+        auto it = sessions_.find(fd);
+        if (it == sessions_.end() || it->second != session) {
+            return;
+        }
+
+        LOG_INFO << "Closing connection, fd=" << fd;
+        handleClientDisconnect(fd);
+    });
 }
 
 void EpollServer::handleClientDisconnect(int fd) {
-    std::cout << "Client disconnected, fd=" << fd << std::endl;
+    LOG_INFO << "Client disconnected, fd=" << fd;
 
     // Remove from epoll
     epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
-    
-    // Close the socket
-    close(fd);
 
-    // Remove from sessions map
+    // Stop pending sends before the fd number can be reused
     auto it = sessions_.find(fd);
-    if (it != sessions_.end()) {
-        sessions_.erase(it);
+    if (it == sessions_.end()) {
+        close(fd);
+        return;
     }
+    SessionPtr session = it->second;
+    session->markClosed();
+    sessions_.erase(it);
 
-    // Notify upper layer
+    // Notify upper layer while the fd is still ours, another reactor may
+    // accept a new connection on the same number as soon as it is closed
     if (disconnectCb_) {
-        disconnectCb_(fd);
+        disconnectCb_(session);
     }
+
+    // Close the socket
+    close(fd);
 }
 
 } // namespace tcp_server
@@ -0,0 +1,145 @@
+#include "EventLoop.h"
+#include "EpollServer.h"
+#include "IoUringServer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "Logger.h"
+
+namespace tcp_server {
+
+namespace {
+
+// Loop whose runOnce() the calling thread is in
+thread_local EventLoop* currentLoop = nullptr;
+
+// Tuning options are best effort: the server still works without them
+void setTuningOption(int fd, int level, int name, int value, const char* label) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+        LOG_WARN << "Failed to set " << label << "=" << value << ": " << strerror(errno);
+    }
+}
+
+// Options inherited by every connection accepted on fd
+void applySocketOptions(int fd, const EventLoopConfig& config) {
+    if (config.tcpNoDelay) {
+        setTuningOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+    // Before listen(), the window scale offered to clients depends on it
+    if (config.recvBufferBytes > 0) {
+        setTuningOption(fd, SOL_SOCKET, SO_RCVBUF, config.recvBufferBytes, "SO_RCVBUF");
+    }
+    if (config.sendBufferBytes > 0) {
+        setTuningOption(fd, SOL_SOCKET, SO_SNDBUF, config.sendBufferBytes, "SO_SNDBUF");
+    }
+    if (config.deferAcceptSeconds > 0) {
+        setTuningOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, config.deferAcceptSeconds,
+                        "TCP_DEFER_ACCEPT");
+    }
+    // Raising it above net.core.busy_read needs CAP_NET_ADMIN
+    if (config.busyPollUs > 0) {
+        setTuningOption(fd, SOL_SOCKET, SO_BUSY_POLL, config.busyPollUs, "SO_BUSY_POLL");
+    }
+}
+
+} // namespace
+
+bool EventLoop::isInLoopThread() const {
+    return currentLoop == this;
+}
+
+EventLoop::LoopScope::LoopScope(EventLoop* loop)
+    : previous_(currentLoop) {
+    currentLoop = loop;
+}
+
+EventLoop::LoopScope::~LoopScope() {
+    currentLoop = previous_;
+}
+
+EventLoopPtr createEventLoop(IoBackend backend, const EventLoopConfig& config, int id,
+                             bool reusePort) {
+    switch (backend) {
+        case IoBackend::IO_URING:
+            return std::make_shared<IoUringServer>(config, id, reusePort);
+
+        case IoBackend::EPOLL:
+        default:
+            return std::make_shared<EpollServer>(config, id, reusePort);
+    }
+}
+
+bool parseIoBackend(const char* name, IoBackend& backend) {
+    if (std::strcmp(name, "epoll") == 0) {
+        backend = IoBackend::EPOLL;
+        return true;
+    }
+    if (std::strcmp(name, "uring") == 0) {
+        backend = IoBackend::IO_URING;
+        return true;
+    }
+    return false;
+}
+
+int openListenSocket(const EventLoopConfig& config, bool reusePort) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR << "Failed to create socket: " << strerror(errno);
+        return -1;
+    }
+
+    // Set SO_REUSEADDR
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        LOG_ERROR << "Failed to set SO_REUSEADDR: " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    // Set SO_REUSEPORT so every reactor can bind its own listen socket
+    // and the kernel spreads incoming connections across them
+    if (reusePort &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        LOG_ERROR << "Failed to set SO_REUSEPORT: " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    applySocketOptions(fd, config);
+
+    // Bind
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(config.port);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR << "Failed to bind: " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    // Listen
+    if (listen(fd, config.listenBacklog > 0 ? config.listenBacklog : SOMAXCONN) < 0) {
+        LOG_ERROR << "Failed to listen: " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    // Set non-blocking
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_ERROR << "Failed to set non-blocking: " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+} // namespace tcp_server
@@ -0,0 +1,72 @@
+#include "Executor.h"
+#include "ThreadPool.h"
+#include "WorkStealingThreadPool.h"
+#include "Logger.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace tcp_server {
+
+ExecutorConfig executorConfig(SchedulerType type, size_t threadCount) {
+    ExecutorConfig config;
+    config.scheduler = type;
+    config.threadCount = threadCount;
+    return config;
+}
+
+ExecutorPtr createExecutor(SchedulerType type, size_t threadCount) {
+    return createExecutor(executorConfig(type, threadCount));
+}
+
+ExecutorPtr createExecutor(const ExecutorConfig& config) {
+    switch (config.scheduler) {
+        case SchedulerType::WORK_STEALING:
+            return std::make_shared<WorkStealingThreadPool>(config);
+
+        case SchedulerType::GLOBAL_QUEUE:
+        default:
+            return std::make_shared<ThreadPool>(config);
+    }
+}
+
+void pinWorkerThread(std::thread& thread, const ExecutorConfig& config, size_t index) {
+    long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (config.firstCpu < 0 || cpuCount <= 0) {
+        return;
+    }
+
+    int cpu = static_cast<int>((config.firstCpu + index) % static_cast<size_t>(cpuCount));
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int err = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    if (err != 0) {
+        LOG_WARN << "Failed to pin worker " << index << " to CPU " << cpu
+                 << ": " << strerror(err);
+    }
+}
+
+const char* priorityName(Priority priority) {
+    switch (priority) {
+        case Priority::HIGH:   return "high";
+        case Priority::NORMAL: return "normal";
+        case Priority::LOW:    return "low";
+    }
+    return "normal";
+}
+
+bool parseSchedulerType(const char* name, SchedulerType& type) {
+    if (std::strcmp(name, "queue") == 0) {
+        type = SchedulerType::GLOBAL_QUEUE;
+        return true;
+    }
+    if (std::strcmp(name, "stealing") == 0) {
+        type = SchedulerType::WORK_STEALING;
+        return true;
+    }
+    return false;
+}
+
+} // namespace tcp_server
@@ -0,0 +1,182 @@
+#include "FlowController.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <vector>
+
+namespace tcp_server {
+
+namespace {
+
+// value reached a high watermark, 0 disables it
+bool aboveHigh(size_t value, size_t high) {
+    return high > 0 && value >= high;
+}
+
+bool belowLow(size_t value, size_t high, size_t low) {
+    return high == 0 || value <= low;
+}
+
+} // namespace
+
+FlowController::FlowController(PauseCallback pauseCb, ResumeCallback resumeCb)
+    : pauseCb_(pauseCb)
+    , resumeCb_(resumeCb)
+    , queuedTasks_(0)
+    , queuedBytes_(0)
+    , overloaded_(false)
+    , deferring_(false) {
+}
+
+bool FlowController::sessionAboveHigh(const Session::FlowState& flow) const {
+    return aboveHigh(flow.tasks, config_.sessionHighTasks) ||
+           aboveHigh(flow.bytes, config_.sessionHighBytes);
+}
+
+bool FlowController::sessionBelowLow(const Session::FlowState& flow) const {
+    return belowLow(flow.tasks, config_.sessionHighTasks, config_.sessionLowTasks) &&
+           belowLow(flow.bytes, config_.sessionHighBytes, config_.sessionLowBytes);
+}
+
+void FlowController::onQueued(const SessionPtr& session, size_t bytes) {
+    size_t tasks = queuedTasks_.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t total = queuedBytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    if (!overloaded_.load(std::memory_order_relaxed) &&
+        (aboveHigh(tasks, config_.globalHighTasks) ||
+         aboveHigh(total, config_.globalHighBytes))) {
+        if (!overloaded_.exchange(true)) {
+            LOG_DEBUG << "Inbound queue above high watermark (" << tasks << " tasks, "
+                      << total << " bytes), pausing reads";
+        }
+    }
+
+    bool pause = false;
+    Session::FlowState& flow = session->getFlowState();
+    {
+        std::lock_guard<std::mutex> lock(flow.mutex);
+        ++flow.tasks;
+        flow.bytes += bytes;
+        if (!flow.paused && (overloaded_.load() || sessionAboveHigh(flow))) {
+            flow.paused = true;
+            pause = true;
+        }
+    }
+
+    if (pause) {
+        {
+            std::lock_guard<std::mutex> lock(pausedMutex_);
+            paused_.insert(session);
+        }
+        ServerMetrics::get().readPauses->add();
+        pauseCb_(session);
+    }
+}
+
+void FlowController::onDone(const SessionPtr& session, size_t bytes) {
+    size_t tasks = queuedTasks_.fetch_sub(1, std::memory_order_relaxed) - 1;
+    size_t total = queuedBytes_.fetch_sub(bytes, std::memory_order_relaxed) - bytes;
+
+    if (overloaded_.load(std::memory_order_relaxed) &&
+        belowLow(tasks, config_.globalHighTasks, config_.globalLowTasks) &&
+        belowLow(total, config_.globalHighBytes, config_.globalLowBytes)) {
+        if (overloaded_.exchange(false) && !deferring_.load()) {
+            LOG_DEBUG << "Inbound queue below low watermark, resuming reads";
+            resumeAll();
+        }
+    }
+
+    bool resume = false;
+    Session::FlowState& flow = session->getFlowState();
+    {
+        std::lock_guard<std::mutex> lock(flow.mutex);
+        --flow.tasks;
+        flow.bytes -= bytes;
+        // While overloaded or deferring, resumeAll() takes care of it
+        if (flow.paused && !overloaded_.load() && !deferring_.load() &&
+            sessionBelowLow(flow)) {
+            flow.paused = false;
+            resume = true;
+        }
+    }
+
+    if (resume) {
+        {
+            std::lock_guard<std::mutex> lock(pausedMutex_);
+            paused_.erase(session);
+        }
+        resumeCb_(session);
+    }
+}
+
+void FlowController::defer(const SessionPtr& session) {
+    deferring_.store(true);
+
+    bool pause = false;
+    Session::FlowState& flow = session->getFlowState();
+    {
+        std::lock_guard<std::mutex> lock(flow.mutex);
+        if (!flow.paused) {
+            flow.paused = true;
+            pause = true;
+        }
+    }
+
+    if (pause) {
+        {
+            std::lock_guard<std::mutex> lock(pausedMutex_);
+            paused_.insert(session);
+        }
+        ServerMetrics::get().deferrals->add();
+        pauseCb_(session);
+    }
+}
+
+void FlowController::endDeferral() {
+    if (deferring_.exchange(false) && !overloaded_.load()) {
+        resumeAll();
+    }
+}
+
+void FlowController::resumeAll() {
+    std::vector<SessionPtr> resumed;
+    {
+        std::lock_guard<std::mutex> lock(pausedMutex_);
+        for (auto it = paused_.begin(); it != paused_.end();) {
+            Session::FlowState& flow = (*it)->getFlowState();
+            std::lock_guard<std::mutex> flowLock(flow.mutex);
+            // Sessions still above their own low watermark resume as
+            // their queued messages complete
+            if (!flow.paused || sessionBelowLow(flow)) {
+                if (flow.paused) {
+                    flow.paused = false;
+                    resumed.push_back(*it);
+                }
+                it = paused_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (const auto& session : resumed) {
+        resumeCb_(session);
+    }
+}
+
+bool FlowController::isPaused(const SessionPtr& session) const {
+    Session::FlowState& flow = session->getFlowState();
+    std::lock_guard<std::mutex> lock(flow.mutex);
+    return flow.paused;
+}
+
+void FlowController::removeSession(const SessionPtr& session) {
+    std::lock_guard<std::mutex> lock(pausedMutex_);
+    paused_.erase(session);
+}
+
+size_t FlowController::getPausedCount() const {
+    std::lock_guard<std::mutex> lock(pausedMutex_);
+    return paused_.size();
+}
+
+} // namespace tcp_server
@@ -1,34 +1,115 @@
 #include "HeartbeatManager.h"
-#include <iostream>
+#include "Logger.h"
 
 namespace tcp_server {
 
+// Wheel resolution
+constexpr int TICK_MS = 1000;
+
 HeartbeatManager::HeartbeatManager(int timeoutSeconds)
-    : timeoutSeconds_(timeoutSeconds) {
+    : timeoutSeconds_(timeoutSeconds)
+    // Rounded up, a deadline is never placed before the full timeout
+    , timeoutTicks_((static_cast<size_t>(timeoutSeconds) * 1000 + TICK_MS - 1) / TICK_MS)
+    , startTime_(std::chrono::steady_clock::now())
+    , currentTick_(0)
+    // Deadlines are normally at most timeoutTicks_ + 1 ahead; entries that
+    // land further out (tick() running late) wait for their round
+    , slots_(timeoutTicks_ + 2) {
+}
+
+uint64_t HeartbeatManager::deadlineTick() const {
+    // Measured from now, not from the last tick(), so the timeout is not
+    // shortened or stretched by how long ago the wheel last moved
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime_).count();
+    uint64_t deadlineMs = static_cast<uint64_t>(elapsed) +
+                          static_cast<uint64_t>(timeoutSeconds_) * 1000;
+    return (deadlineMs + TICK_MS - 1) / TICK_MS;
 }
 
 void HeartbeatManager::updateHeartbeat(SessionPtr session) {
-    if (session) {
-        session->updateHeartbeat();
+    if (!session || session->isClosed()) {
+        return;
+    }
+
+    session->updateHeartbeat();
+    uint64_t deadline = deadlineTick();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t slot = static_cast<size_t>(deadline % slots_.size());
+
+    auto it = entries_.find(session->getFd());
+    if (it != entries_.end() && it->second.session.lock() == session) {
+        // Reschedule: move the node to its new slot without reallocating
+        Entry& entry = it->second;
+        slots_[slot].splice(slots_[slot].end(), slots_[entry.slot], entry.position);
+        entry.slot = slot;
+        entry.deadline = deadline;
+        return;
+    }
+
+    if (it != entries_.end()) {
+        // Stale entry left by an earlier connection on the same fd
+        slots_[it->second.slot].erase(it->second.position);
+        entries_.erase(it);
+    }
+
+    Entry entry;
+    entry.session = session;
+    entry.slot = slot;
+    entry.deadline = deadline;
+    entry.position = slots_[slot].insert(slots_[slot].end(), session->getFd());
+    entries_.insert(std::make_pair(session->getFd(), entry));
+}
+
+void HeartbeatManager::removeSession(const SessionPtr& session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(session->getFd());
+    if (it != entries_.end() && it->second.session.lock() == session) {
+        slots_[it->second.slot].erase(it->second.position);
+        entries_.erase(it);
     }
 }
 
-std::vector<int> HeartbeatManager::checkTimeouts(const std::vector<SessionPtr>& sessions) {
-    std::vector<int> timedOutFds;
-    auto now = std::chrono::steady_clock::now();
+std::vector<SessionPtr> HeartbeatManager::tick() {
+    std::vector<SessionPtr> timedOut;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime_).count();
+    uint64_t targetTick = static_cast<uint64_t>(elapsed / TICK_MS);
 
-    for (const auto& session : sessions) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            now - session->getLastHeartbeat()).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (currentTick_ < targetTick) {
+        ++currentTick_;
 
-        if (elapsed > timeoutSeconds_) {
-            std::cout << "Session timeout detected, fd=" << session->getFd()
-                     << ", elapsed=" << elapsed << "s" << std::endl;
-            timedOutFds.push_back(session->getFd());
+        // Entries of this slot reached their deadline, unless they are
+        // a full round of the wheel further out
+        SlotList& slot = slots_[currentTick_ % slots_.size()];
+        for (auto pos = slot.begin(); pos != slot.end();) {
+            int fd = *pos;
+            auto it = entries_.find(fd);
+            if (it->second.deadline > currentTick_) {
+                ++pos;
+                continue;
+            }
+            // Hand back the session itself, the fd alone may be reused
+            // by a newer connection before the close reaches its reactor
+            if (SessionPtr session = it->second.session.lock()) {
+                LOG_INFO << "Session timeout detected, fd=" << fd
+                        << ", timeout=" << timeoutSeconds_ << "s";
+                timedOut.push_back(std::move(session));
+            }
+            entries_.erase(it);
+            pos = slot.erase(pos);
         }
     }
 
-    return timedOutFds;
+    return timedOut;
+}
+
+size_t HeartbeatManager::getTrackedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
 }
 
 } // namespace tcp_server
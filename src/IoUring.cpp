@@ -0,0 +1,206 @@
+#include "IoUring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include "Logger.h"
+
+namespace tcp_server {
+
+namespace {
+
+int sysSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+             const void* arg, size_t argSize) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+} // namespace
+
+IoUring::IoUring()
+    : ringFd_(-1)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqArray_(nullptr)
+    , sqMask_(0)
+    , sqEntries_(0)
+    , sqes_(nullptr)
+    , sqeTail_(0)
+    , sqeSubmitted_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(0)
+    , cqes_(nullptr)
+    , sqRing_(MAP_FAILED)
+    , sqRingSize_(0)
+    , cqRing_(MAP_FAILED)
+    , cqRingSize_(0)
+    , sqesSize_(0) {
+}
+
+IoUring::~IoUring() {
+    close();
+}
+
+bool IoUring::init(unsigned sqEntries, unsigned cqEntries) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = cqEntries;
+
+    ringFd_ = sysSetup(sqEntries, &params);
+    if (ringFd_ < 0) {
+        LOG_ERROR << "io_uring_setup failed: " << strerror(errno);
+        return false;
+    }
+
+    // Timed waits need EXT_ARG (5.11+), multishot needs a newer kernel still
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        LOG_ERROR << "io_uring: kernel lacks IORING_FEAT_EXT_ARG";
+        close();
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cqRingSize_ > sqRingSize_) {
+            sqRingSize_ = cqRingSize_;
+        }
+        cqRingSize_ = sqRingSize_;
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        LOG_ERROR << "io_uring: failed to map SQ ring: " << strerror(errno);
+        close();
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            LOG_ERROR << "io_uring: failed to map CQ ring: " << strerror(errno);
+            close();
+            return false;
+        }
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_ERROR << "io_uring: failed to map SQEs: " << strerror(errno);
+        close();
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // SQE slots are handed out in ring order, so the indirection is fixed
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+        sqArray_[i] = i;
+    }
+    sqeTail_ = *sqTail_;
+    sqeSubmitted_ = sqeTail_;
+
+    return true;
+}
+
+void IoUring::close() {
+    if (sqes_) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = MAP_FAILED;
+    if (sqRing_ != MAP_FAILED) {
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = MAP_FAILED;
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+struct io_uring_sqe* IoUring::getSqe() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_) {
+        // Full: push what we have to the kernel to free slots
+        if (submitAndWait(0) < 0) {
+            return nullptr;
+        }
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqeTail_ - head >= sqEntries_) {
+            return nullptr;
+        }
+    }
+
+    struct io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned IoUring::flushSq() {
+    unsigned pending = sqeTail_ - sqeSubmitted_;
+    if (pending > 0) {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+        sqeSubmitted_ = sqeTail_;
+    }
+    return pending;
+}
+
+int IoUring::submitAndWait(int timeoutMs) {
+    unsigned toSubmit = flushSq();
+
+    if (timeoutMs == 0) {
+        if (toSubmit == 0) {
+            return 0;
+        }
+        int ret = sysEnter(ringFd_, toSubmit, 0, 0, nullptr, 0);
+        return ret < 0 ? -errno : ret;
+    }
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int ret = sysEnter(ringFd_, toSubmit, 1,
+                       IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                       &arg, sizeof(arg));
+    return ret < 0 ? -errno : ret;
+}
+
+} // namespace tcp_server
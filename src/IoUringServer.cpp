@@ -0,0 +1,602 @@
+#include "IoUringServer.h"
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "Logger.h"
+#include "Metrics.h"
+
+namespace tcp_server {
+
+constexpr unsigned URING_SQ_ENTRIES = 4096;
+constexpr unsigned URING_CQ_ENTRIES = 16384;
+
+
+// Provided recv buffers shared by all connections of a reactor, each
+// EventLoopConfig::recvChunkBytes long. Each is copied into the session's
+// PacketBuffer and handed straight back.
+constexpr uint16_t RECV_BUFFER_COUNT = 512;
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+
+constexpr uint64_t OP_TYPE_MASK = 0x7;
+
+namespace {
+
+uint64_t packUserData(const void* ptr, uint64_t op) {
+    return reinterpret_cast<uint64_t>(ptr) | op;
+}
+
+} // namespace
+
+IoUringServer::IoUringServer(const EventLoopConfig& config, int id, bool reusePort)
+    : config_(config)
+    , id_(id)
+    , reusePort_(reusePort)
+    , listenFd_(-1)
+    , wakeupFd_(-1)
+    , running_(false)
+    , inLoop_(false)
+    , wakeupValue_(0) {
+    if (config_.recvChunkBytes == 0) {
+        config_.recvChunkBytes = 1;
+    }
+    setReadBudget(config_.readBudgetBytes, config_.readBudgetMessages);
+}
+
+void IoUringServer::setReadBudget(size_t, size_t messages) {
+    config_.readBudgetMessages = messages > 0 ? messages : 1;
+}
+
+IoUringServer::~IoUringServer() {
+    stop();
+}
+
+void IoUringServer::provideBuffers(uint16_t firstId, uint16_t count) {
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        LOG_ERROR << "io_uring: no SQE to provide buffers";
+        return;
+    }
+
+    // Consecutive ids map to consecutive recvChunkBytes slices
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = count;
+    sqe->addr = reinterpret_cast<uint64_t>(bufferMemory_.get() +
+                                           firstId * config_.recvChunkBytes);
+    sqe->len = static_cast<uint32_t>(config_.recvChunkBytes);
+    sqe->off = firstId;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = packUserData(nullptr, OP_PROVIDE);
+}
+
+bool IoUringServer::start() {
+    if (running_) {
+        return true;
+    }
+
+    if (!ring_.init(URING_SQ_ENTRIES, URING_CQ_ENTRIES)) {
+        return false;
+    }
+
+    listenFd_ = openListenSocket(config_, reusePort_);
+    if (listenFd_ < 0) {
+        stop();
+        return false;
+    }
+    LOG_INFO << "Listening on port " << config_.port << ", reactor=" << id_ << " (io_uring)";
+
+    // Blocking eventfd: io_uring reads on an O_NONBLOCK file fail with
+    // EAGAIN instead of waiting
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC);
+    if (wakeupFd_ < 0) {
+        LOG_ERROR << "Failed to create eventfd: " << strerror(errno);
+        stop();
+        return false;
+    }
+
+    running_ = true;
+    bufferMemory_.reset(new char[RECV_BUFFER_COUNT * config_.recvChunkBytes]);
+    provideBuffers(0, RECV_BUFFER_COUNT);
+    armAccept();
+    armWakeup();
+
+    LOG_INFO << "Server started successfully";
+    return true;
+}
+
+void IoUringServer::stop() {
+    if (!running_ && !ring_.isOpen()) {
+        return;
+    }
+
+    running_ = false;
+
+    // Called from a signal handler that interrupted runOnce(): freeing
+    // connections now would pull them from under the running handler
+    if (inLoop_) {
+        return;
+    }
+    releaseResources();
+}
+
+void IoUringServer::releaseResources() {
+    // Closing the ring cancels every request still in flight, only then
+    // is it safe to free the memory they point at
+    ring_.close();
+
+    for (auto& pair : connections_) {
+        pair.second->session->markClosed();
+        close(pair.first);
+        delete pair.second;
+    }
+    connections_.clear();
+
+    bufferMemory_.reset();
+
+    if (wakeupFd_ >= 0) {
+        close(wakeupFd_);
+        wakeupFd_ = -1;
+    }
+
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+    }
+
+    LOG_INFO << "Server stopped";
+}
+
+void IoUringServer::runOnce(int timeoutMs) {
+    if (!running_) {
+        return;
+    }
+
+    LoopScope scope(this);
+    inLoop_ = true;
+
+    // Sends queued by the previous iteration go out with this wait
+    // Connections on the ready list still hold messages, do not block
+    int ret = ring_.submitAndWait(readyList_.empty() ? timeoutMs : 0);
+    if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+        LOG_ERROR << "io_uring_enter error: " << strerror(-ret);
+    }
+
+    if (running_) {
+        ring_.forEachCqe([this](const struct io_uring_cqe& cqe) { handleCompletion(cqe); });
+
+        serviceReadyList();
+        doPendingFunctors();
+        doPendingFlushes();
+    }
+
+    inLoop_ = false;
+
+    // stop() ran from a signal handler during this iteration
+    if (!running_) {
+        releaseResources();
+    }
+}
+
+void IoUringServer::armAccept() {
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        LOG_ERROR << "io_uring: no SQE for accept";
+        return;
+    }
+
+    // Blocking sockets are fine, io_uring waits for readiness itself
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = packUserData(nullptr, OP_ACCEPT);
+}
+
+bool IoUringServer::armRecv(Connection* conn) {
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        LOG_ERROR << "io_uring: no SQE for recv, fd=" << conn->fd;
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = packUserData(conn, OP_RECV);
+    ++conn->pendingOps;
+    conn->recvArmed = true;
+    return true;
+}
+
+void IoUringServer::armWakeup() {
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        LOG_ERROR << "io_uring: no SQE for wakeup";
+        return;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeupFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+    sqe->len = sizeof(wakeupValue_);
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->user_data = packUserData(nullptr, OP_WAKEUP);
+}
+
+void IoUringServer::submitSend(Connection* conn) {
+    if (conn->closed) {
+        return;
+    }
+
+    size_t iovCount = conn->session->prepareAsyncWrite(conn->iov, MAX_IOV_PER_WRITE);
+    if (iovCount == 0) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        conn->session->completeAsyncWrite(-EBUSY);
+        handleClientDisconnect(conn);
+        return;
+    }
+
+    std::memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = iovCount;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&conn->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = packUserData(conn, OP_SEND);
+    ++conn->pendingOps;
+}
+
+void IoUringServer::handleCompletion(const struct io_uring_cqe& cqe) {
+    uint64_t op = cqe.user_data & OP_TYPE_MASK;
+    Connection* conn = reinterpret_cast<Connection*>(cqe.user_data & ~OP_TYPE_MASK);
+
+    switch (op) {
+        case OP_ACCEPT:
+            handleAccept(cqe);
+            break;
+        case OP_RECV:
+            handleRecv(conn, cqe);
+            break;
+        case OP_SEND:
+            handleSend(conn, cqe);
+            break;
+        case OP_PROVIDE:
+            // Only failures post a completion
+            LOG_ERROR << "io_uring: failed to provide buffers: " << strerror(-cqe.res);
+            break;
+        case OP_CANCEL:
+            // Only failures post a completion, the recv was already done
+            break;
+        case OP_WAKEUP:
+            // Woken up by another thread
+            if (running_) {
+                armWakeup();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void IoUringServer::handleAccept(const struct io_uring_cqe& cqe) {
+    if (cqe.res >= 0) {
+        int clientFd = cqe.res;
+
+        Connection* conn = new Connection();
+        conn->fd = clientFd;
+        conn->closed = false;
+        conn->recvArmed = false;
+        conn->pendingOps = 0;
+
+        // Create session
+        auto session = Session::create(clientFd);
+        session->setReactorId(id_);
+        session->setFlushRequestCallback(
+            [this](int fd) { requestFlush(fd); });
+        session->setWriteCoalescing(true);
+        conn->session = session;
+        connections_[clientFd] = conn;
+
+        struct sockaddr_in clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+        std::memset(&clientAddr, 0, sizeof(clientAddr));
+        getpeername(clientFd, (struct sockaddr*)&clientAddr, &clientLen);
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, ip, sizeof(ip));
+        LOG_INFO << "New connection from " << ip << ":"
+                 << ntohs(clientAddr.sin_port)
+                 << ", fd=" << clientFd;
+
+        if (!armRecv(conn)) {
+            handleClientDisconnect(conn);
+        } else if (newConnectionCb_) {
+            newConnectionCb_(session);
+        }
+        releaseIfDone(conn);
+    } else if (cqe.res != -ECANCELED) {
+        LOG_ERROR << "Accept error: " << strerror(-cqe.res);
+    }
+
+    // The kernel ends a multishot accept on errors, start a new one
+    if (!(cqe.flags & IORING_CQE_F_MORE) && running_) {
+        armAccept();
+    }
+}
+
+void IoUringServer::handleRecv(Connection* conn, const struct io_uring_cqe& cqe) {
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        uint16_t bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe.res > 0 && !conn->closed) {
+            PacketBuffer& packetBuffer = conn->session->getBuffer();
+            packetBuffer.append(bufferMemory_.get() + bufferId * config_.recvChunkBytes, cqe.res);
+            ServerMetrics::get().bytesIn->add(cqe.res);
+        }
+        provideBuffers(bufferId, 1);
+
+        // Connections already waiting on the ready list get their turn there
+        if (cqe.res > 0 && !readySet_.count(conn->fd) && !deliverMessages(conn)) {
+            markReady(conn->fd);
+        }
+    }
+
+    if (!more) {
+        --conn->pendingOps;
+        conn->recvArmed = false;
+        if (!conn->closed) {
+            bool restartable = cqe.res > 0 || cqe.res == -ENOBUFS || cqe.res == -ECANCELED;
+            if (restartable && conn->session->isReadPaused()) {
+                // Cancelled by pauseReading(), resumeReading() re-arms it
+            } else if (restartable) {
+                // Multishot ended early, ran out of buffers or was cancelled
+                // by a pause that has been lifted since, start over
+                if (!armRecv(conn)) {
+                    handleClientDisconnect(conn);
+                }
+            } else {
+                if (cqe.res < 0) {
+                    LOG_ERROR << "Recv error: " << strerror(-cqe.res);
+                }
+                // Connection closed
+                handleClientDisconnect(conn);
+            }
+        }
+    }
+
+    releaseIfDone(conn);
+}
+
+bool IoUringServer::deliverMessages(Connection* conn) {
+    // Complete messages beyond a pause stay in the buffer until resumed
+    size_t budget = config_.readBudgetMessages;
+    int64_t arrivalNs = 0;
+    while (!conn->closed && !conn->session->isReadPaused()) {
+        if (budget == 0) {
+            return false;
+        }
+        Message message;
+        if (!conn->session->getBuffer().extractMessage(message)) {
+            break;
+        }
+        --budget;
+        // One clock read covers the whole batch
+        if (arrivalNs == 0) {
+            arrivalNs = metricsNowNs();
+        }
+        message.setArrivalNs(arrivalNs);
+        if (messageCb_) {
+            messageCb_(conn->session, message);
+        }
+    }
+    return true;
+}
+
+void IoUringServer::markReady(int fd) {
+    if (readySet_.insert(fd).second) {
+        readyList_.push_back(fd);
+    }
+}
+
+void IoUringServer::serviceReadyList() {
+    // One more budget for each connection that was waiting
+    std::vector<int> ready;
+    ready.swap(readyList_);
+    readySet_.clear();
+
+    for (int fd : ready) {
+        auto it = connections_.find(fd);
+        if (it != connections_.end() && !deliverMessages(it->second)) {
+            markReady(fd);
+        }
+    }
+}
+
+void IoUringServer::handleSend(Connection* conn, const struct io_uring_cqe& cqe) {
+    --conn->pendingOps;
+
+    bool ok = conn->session->completeAsyncWrite(cqe.res);
+    if (!conn->closed) {
+        if (ok) {
+            // Anything queued meanwhile, or left over from a short write
+            submitSend(conn);
+        } else {
+            handleClientDisconnect(conn);
+        }
+    }
+
+    releaseIfDone(conn);
+}
+
+void IoUringServer::queueInLoop(Functor functor) {
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        pendingFunctors_.push_back(std::move(functor));
+    }
+    wakeup();
+}
+
+void IoUringServer::wakeup() {
+    if (wakeupFd_ < 0) {
+        return;
+    }
+
+    uint64_t one = 1;
+    ssize_t n = write(wakeupFd_, &one, sizeof(one));
+    (void)n;
+}
+
+void IoUringServer::requestFlush(int fd) {
+    bool needWakeup;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        needWakeup = pendingFlushes_.empty();
+        pendingFlushes_.push_back(fd);
+    }
+
+    // Sends from the loop thread itself (inline handlers) are submitted at
+    // the end of this iteration, no need to interrupt the next wait
+    if (needWakeup && !isInLoopThread()) {
+        wakeup();
+    }
+}
+
+void IoUringServer::doPendingFlushes() {
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        fds.swap(pendingFlushes_);
+    }
+
+    for (int fd : fds) {
+        auto it = connections_.find(fd);
+        if (it != connections_.end()) {
+            Connection* conn = it->second;
+            submitSend(conn);
+            releaseIfDone(conn);
+        }
+    }
+}
+
+void IoUringServer::doPendingFunctors() {
+    std::vector<Functor> functors;
+    {
+        std::lock_guard<std::mutex> lock(functorMutex_);
+        functors.swap(pendingFunctors_);
+    }
+
+    for (auto& functor : functors) {
+        functor();
+    }
+}
+
+void IoUringServer::closeConnection(const SessionPtr& session) {
+    if (!running_) {
+        return;
+    }
+
+    // The connection table is owned by the loop thread, so defer the close to it
+    queueInLoop([this, session]() {
+        Connection* conn = findConnection(session);
+        if (!conn) {
+            return;
+        }
+
+        LOG_INFO << "Closing connection, fd=" << conn->fd;
+        handleClientDisconnect(conn);
+        releaseIfDone(conn);
+    });
+}
+
+IoUringServer::Connection* IoUringServer::findConnection(const SessionPtr& session) {
+    // The fd may belong to a newer connection by now
+    auto it = connections_.find(session->getFd());
+    if (it == connections_.end() || it->second->session != session) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void IoUringServer::pauseReading(const SessionPtr& session) {
+    Connection* conn = findConnection(session);
+    if (!conn || session->isReadPaused()) {
+        return;
+    }
+
+    session->setReadPaused(true);
+    if (!conn->recvArmed) {
+        return;
+    }
+
+    // Stop the multishot recv, data it already delivered is still handled
+    struct io_uring_sqe* sqe = ring_.getSqe();
+    if (!sqe) {
+        LOG_ERROR << "io_uring: no SQE to pause recv, fd=" << conn->fd;
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = packUserData(conn, OP_RECV);
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = packUserData(nullptr, OP_CANCEL);
+}
+
+void IoUringServer::resumeReading(const SessionPtr& session) {
+    Connection* conn = findConnection(session);
+    if (!conn || !session->isReadPaused()) {
+        return;
+    }
+
+    session->setReadPaused(false);
+    if (!deliverMessages(conn)) {
+        markReady(conn->fd);
+    }
+
+    // Still armed if the cancel has not completed yet; its completion
+    // re-arms once it sees the pause lifted
+    if (!session->isReadPaused() && !conn->recvArmed && !armRecv(conn)) {
+        handleClientDisconnect(conn);
+        releaseIfDone(conn);
+    }
+}
+
+void IoUringServer::handleClientDisconnect(Connection* conn) {
+    int fd = conn->fd;
+    LOG_INFO << "Client disconnected, fd=" << fd;
+
+    connections_.erase(fd);
+    conn->closed = true;
+
+    // Stop pending sends before the fd number can be reused
+    conn->session->markClosed();
+
+    // Notify upper layer while the fd is still ours, another reactor may
+    // accept a new connection on the same number as soon as it is closed
+    if (disconnectCb_) {
+        disconnectCb_(conn->session);
+    }
+
+    // Shutdown completes the outstanding recv, the requests keep their
+    // own reference to the socket so closing alone would not
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+
+void IoUringServer::releaseIfDone(Connection* conn) {
+    if (conn->closed && conn->pendingOps == 0) {
+        delete conn;
+    }
+}
+
+} // namespace tcp_server
@@ -0,0 +1,404 @@
+#include "Logger.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tcp_server {
+
+namespace {
+
+// Records buffered per thread before logging starts to drop
+constexpr size_t RING_CAPACITY = 1024;
+
+// How often the writer drains the rings when nobody asks for a flush
+constexpr int FLUSH_INTERVAL_MS = 10;
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::TRACE: return "TRACE";
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO:  return "INFO ";
+        case LogLevel::WARN:  return "WARN ";
+        case LogLevel::ERROR: return "ERROR";
+        default:              return "?????";
+    }
+}
+
+struct LogRecord {
+    int64_t timestampUs;
+    LogLevel level;
+    uint16_t length;
+    char text[LOG_LINE_SIZE];
+};
+
+// Single-producer single-consumer ring owned by one logging thread
+class LogRing {
+public:
+    explicit LogRing(uint32_t threadId)
+        : threadId_(threadId), head_(0), tail_(0), abandoned_(false) {}
+
+    // Producer side
+    LogRecord* beginPush() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == RING_CAPACITY) {
+            return nullptr;
+        }
+        return &records_[tail % RING_CAPACITY];
+    }
+    void commitPush() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side
+    size_t head() const { return head_.load(std::memory_order_relaxed); }
+    size_t tail() const { return tail_.load(std::memory_order_acquire); }
+    const LogRecord& at(size_t index) const { return records_[index % RING_CAPACITY]; }
+    void release(size_t newHead) { head_.store(newHead, std::memory_order_release); }
+
+    uint32_t threadId() const { return threadId_; }
+    bool isAbandoned() const { return abandoned_.load(); }
+    void abandon() { abandoned_.store(true); }
+
+private:
+    uint32_t threadId_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    std::atomic<bool> abandoned_;
+    LogRecord records_[RING_CAPACITY];
+};
+
+// Marks the calling thread's ring abandoned when the thread exits
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+        if (ring) {
+            ring->abandon();
+        }
+    }
+};
+
+thread_local ThreadRing threadRing;
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void shutdownAtExit() {
+    Logger::instance().shutdown();
+}
+
+} // namespace
+
+struct Logger::Impl {
+    struct PendingRecord {
+        int64_t timestampUs;
+        LogRing* ring;
+        size_t index;
+
+        bool operator<(const PendingRecord& other) const {
+            return timestampUs < other.timestampUs;
+        }
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+
+    std::mutex writerMutex;              // serializes draining
+    std::vector<PendingRecord> pending;  // reused by every drain
+    std::vector<std::shared_ptr<LogRing>> drainRings;
+    uint64_t reportedDrops = 0;
+    int64_t cachedSecond = -1;
+    char cachedTime[32];
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    uint64_t flushRequested = 0;
+    uint64_t flushCompleted = 0;
+    bool stopping = false;
+    std::atomic<bool> stopped{false};
+    std::thread writer;
+
+    LogRing* currentRing() {
+        if (!threadRing.ring) {
+            uint32_t tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+            threadRing.ring = std::make_shared<LogRing>(tid);
+            std::lock_guard<std::mutex> lock(registryMutex);
+            rings.push_back(threadRing.ring);
+        }
+        return threadRing.ring.get();
+    }
+
+    void writeRecord(const LogRecord& record, uint32_t threadId) {
+        int64_t second = record.timestampUs / 1000000;
+        if (second != cachedSecond) {
+            time_t t = static_cast<time_t>(second);
+            struct tm tmValue;
+            localtime_r(&t, &tmValue);
+            strftime(cachedTime, sizeof(cachedTime), "%Y-%m-%d %H:%M:%S", &tmValue);
+            cachedSecond = second;
+        }
+
+        FILE* out = record.level >= LogLevel::WARN ? stderr : stdout;
+        if (out == stderr) {
+            // Keep lines whole when both streams go to the same file
+            fflush(stdout);
+        }
+        fprintf(out, "%s.%06d %s %u ", cachedTime, 
+                static_cast<int>(record.timestampUs % 1000000),
+                levelName(record.level), threadId);
+        fwrite(record.text, 1, record.length, out);
+        fputc('\n', out);
+    }
+
+    // Write out everything the rings hold, oldest first
+    void drain(uint64_t droppedTotal) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+
+        {
+            std::lock_guard<std::mutex> registryLock(registryMutex);
+            drainRings = rings;
+        }
+
+        pending.clear();
+        for (auto& ring : drainRings) {
+            size_t tail = ring->tail();
+            for (size_t i = ring->head(); i < tail; ++i) {
+                PendingRecord entry;
+                entry.timestampUs = ring->at(i).timestampUs;
+                entry.ring = ring.get();
+                entry.index = i;
+                pending.push_back(entry);
+            }
+        }
+
+        std::stable_sort(pending.begin(), pending.end());
+        for (const auto& entry : pending) {
+            writeRecord(entry.ring->at(entry.index), entry.ring->threadId());
+            entry.ring->release(entry.index + 1);
+        }
+
+        if (droppedTotal != reportedDrops) {
+            fflush(stdout);
+            fprintf(stderr, "[logger] %llu log records dropped\n",
+                    static_cast<unsigned long long>(droppedTotal - reportedDrops));
+            reportedDrops = droppedTotal;
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+
+        // Forget rings of exited threads once they are empty
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        rings.erase(std::remove_if(rings.begin(), rings.end(),
+            [](const std::shared_ptr<LogRing>& ring) {
+                return ring->isAbandoned() && ring->head() == ring->tail();
+            }), rings.end());
+        drainRings.clear();
+    }
+};
+
+Logger& Logger::instance() {
+    // Intentionally leaked so logging keeps working during static destruction
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger()
+    : level_(static_cast<int>(LogLevel::INFO))
+    , dropped_(0)
+    , impl_(new Impl()) {
+
+    impl_->writer = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(impl_->wakeMutex);
+        while (true) {
+            impl_->wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), 
+                [this]() {
+                    return impl_->stopping || 
+                           impl_->flushRequested != impl_->flushCompleted;
+                });
+            bool stopping = impl_->stopping;
+            uint64_t requested = impl_->flushRequested;
+            lock.unlock();
+
+            impl_->drain(dropped_.load());
+
+            lock.lock();
+            impl_->flushCompleted = requested;
+            impl_->flushed.notify_all();
+            if (stopping) {
+                return;
+            }
+        }
+    });
+
+    std::atexit(shutdownAtExit);
+}
+
+void Logger::write(LogLevel level, const char* text, size_t len) {
+    if (len > LOG_LINE_SIZE) {
+        len = LOG_LINE_SIZE;
+    }
+
+    if (impl_->stopped.load()) {
+        // Writer is gone, fall back to a synchronous write
+        LogRecord record;
+        record.timestampUs = nowMicros();
+        record.level = level;
+        record.length = static_cast<uint16_t>(len);
+        std::memcpy(record.text, text, len);
+        std::lock_guard<std::mutex> lock(impl_->writerMutex);
+        impl_->writeRecord(record, static_cast<uint32_t>(::syscall(SYS_gettid)));
+        fflush(level >= LogLevel::WARN ? stderr : stdout);
+        return;
+    }
+
+    LogRing* ring = impl_->currentRing();
+    LogRecord* record = ring->beginPush();
+    if (!record) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    record->timestampUs = nowMicros();
+    record->level = level;
+    record->length = static_cast<uint16_t>(len);
+    std::memcpy(record->text, text, len);
+    ring->commitPush();
+}
+
+void Logger::flush() {
+    if (impl_->stopped.load()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(impl_->wakeMutex);
+    uint64_t target = ++impl_->flushRequested;
+    impl_->wake.notify_one();
+    impl_->flushed.wait(lock, [this, target]() {
+        return impl_->flushCompleted >= target || impl_->stopped.load();
+    });
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->wakeMutex);
+        if (impl_->stopping) {
+            return;
+        }
+        impl_->stopping = true;
+        impl_->wake.notify_one();
+    }
+
+    if (impl_->writer.joinable()) {
+        impl_->writer.join();
+    }
+
+    impl_->stopped.store(true);
+
+    // Pick up anything logged while the writer was exiting
+    impl_->drain(dropped_.load());
+}
+
+bool parseLogLevel(const char* name, LogLevel& level) {
+    static const struct {
+        const char* name;
+        LogLevel level;
+    } levels[] = {
+        {"trace", LogLevel::TRACE},
+        {"debug", LogLevel::DEBUG},
+        {"info", LogLevel::INFO},
+        {"warn", LogLevel::WARN},
+        {"error", LogLevel::ERROR},
+        {"off", LogLevel::OFF},
+    };
+
+    for (const auto& entry : levels) {
+        if (std::strcmp(name, entry.name) == 0) {
+            level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+LogStream& LogStream::operator<<(const char* value) {
+    if (value) {
+        append(value, std::strlen(value));
+    } else {
+        append("(null)", 6);
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(double value) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%g", value);
+    if (n > 0) {
+        append(buf, static_cast<size_t>(n));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void* value) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%p", value);
+    if (n > 0) {
+        append(buf, static_cast<size_t>(n));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+    if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::hex)) {
+        hex_ = true;
+    } else if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::dec)) {
+        hex_ = false;
+    }
+    return *this;
+}
+
+void LogStream::append(const char* data, size_t len) {
+    size_t room = LOG_LINE_SIZE - len_;
+    if (len > room) {
+        len = room;
+    }
+    std::memcpy(buffer_ + len_, data, len);
+    len_ += len;
+}
+
+LogStream& LogStream::formatSigned(long long value) {
+    if (value < 0 && !hex_) {
+        append("-", 1);
+        return formatUnsigned(0ULL - static_cast<unsigned long long>(value));
+    }
+    return formatUnsigned(static_cast<unsigned long long>(value));
+}
+
+LogStream& LogStream::formatUnsigned(unsigned long long value) {
+    static const char digits[] = "0123456789abcdef";
+    unsigned base = hex_ ? 16 : 10;
+
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = digits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    append(p, static_cast<size_t>(end - p));
+    return *this;
+}
+
+} // namespace tcp_server
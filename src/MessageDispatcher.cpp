@@ -1,5 +1,7 @@
 #include "MessageDispatcher.h"
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
+#include "Strand.h"
 #include <cstring>
 
 namespace tcp_server {
@@ -8,59 +10,142 @@ MessageDispatcher::MessageDispatcher(SessionManagerPtr sessionMgr,
                                     HeartbeatManagerPtr heartbeatMgr)
     : sessionMgr_(sessionMgr)
     , heartbeatMgr_(heartbeatMgr) {
+    for (size_t type = 0; type < HANDLER_TABLE_SIZE; ++type) {
+        handlers_[type].priority = messagePriority(static_cast<uint16_t>(type));
+    }
+
+    // Built-in message types
+    registerHandler<MessageType::LOGIN_REQUEST, LoginRequest>(ExecutionPolicy::POOL,
+        [this](const SessionPtr& session, const LoginRequest& req, const Message&) {
+            handleLoginRequest(session, req);
+        });
+    // Heartbeats only touch a timestamp and echo the header, handled on
+    // the reactor so they are never stuck behind a busy pool
+    registerHandler<MessageType::HEARTBEAT, NoBody>(ExecutionPolicy::INLINE,
+        [this](const SessionPtr& session, const NoBody&, const Message&) {
+            handleHeartbeatInline(session);
+        });
+    registerHandler<MessageType::DATA, NoBody>(ExecutionPolicy::POOL,
+        [this](const SessionPtr& session, const NoBody&, const Message& message) {
+            handleDataMessage(session, message);
+        });
+
+    handlers_[static_cast<uint16_t>(MessageType::LOGIN_REQUEST)].sheddable = false;
+    handlers_[static_cast<uint16_t>(MessageType::HEARTBEAT)].sheddable = false;
+}
+
+bool MessageDispatcher::registerRawHandler(uint16_t type, ExecutionPolicy policy,
+                                           Handler handler) {
+    if (type == 0 || type >= HANDLER_TABLE_SIZE) {
+        LOG_ERROR << "Cannot register handler for message type " << type;
+        return false;
+    }
+
+    handlers_[type].handler = std::move(handler);
+    handlers_[type].policy = policy;
+    return true;
+}
+
+bool MessageDispatcher::usesPolicy(ExecutionPolicy policy) const {
+    for (const auto& entry : handlers_) {
+        if (entry.handler && entry.policy == policy) {
+            return true;
+        }
+    }
+    return false;
 }
 
-void MessageDispatcher::dispatch(SessionPtr session, 
-                                const MessageHeader& header,
-                                const std::vector<char>& body) {
-    MessageType type = static_cast<MessageType>(header.type);
+bool MessageDispatcher::setPriority(uint16_t type, Priority priority) {
+    if (type == 0 || type >= HANDLER_TABLE_SIZE) {
+        LOG_ERROR << "Cannot set the priority of message type " << type;
+        return false;
+    }
 
-    switch (type) {
-        case MessageType::LOGIN_REQUEST:
-            handleLoginRequest(session, body);
-            break;
+    handlers_[type].priority = priority;
+    return true;
+}
 
-        case MessageType::HEARTBEAT:
-            handleHeartbeat(session);
-            break;
+bool MessageDispatcher::setDeadline(uint16_t type, std::chrono::milliseconds deadline) {
+    if (type == 0 || type >= HANDLER_TABLE_SIZE || neverShed(type)) {
+        LOG_ERROR << "Cannot set a deadline for message type " << type;
+        return false;
+    }
+
+    handlers_[type].deadlineNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline).count();
+    return true;
+}
 
-        case MessageType::DATA:
-            handleDataMessage(session, body);
-            break;
+bool MessageDispatcher::setSheddable(uint16_t type, bool sheddable) {
+    if (type == 0 || type >= HANDLER_TABLE_SIZE || neverShed(type)) {
+        LOG_ERROR << "Cannot change shedding of message type " << type;
+        return false;
+    }
 
-        default:
-            std::cerr << "Unknown message type: " << header.type << std::endl;
-            break;
+    handlers_[type].sheddable = sheddable;
+    if (!sheddable) {
+        handlers_[type].deadlineNs = 0;
     }
+    return true;
+}
+
+void MessageDispatcher::reportShortBody(uint16_t type, size_t bodyLength, size_t expected) {
+    LOG_ERROR << "Message type " << type << " body too short: " << bodyLength
+              << " bytes, expected " << expected;
 }
 
-void MessageDispatcher::handleLoginRequest(SessionPtr session, 
-                                          const std::vector<char>& body) {
-    if (body.size() < sizeof(LoginRequest)) {
-        std::cerr << "Invalid login request size" << std::endl;
+void MessageDispatcher::dispatch(SessionPtr session, const Message& message) {
+    uint16_t type = message.getHeader().type;
+    ServerMetrics& metrics = ServerMetrics::get();
+    size_t slot = ServerMetrics::typeSlot(type);
+    int64_t startNs = metricsNowNs();
+
+    const HandlerEntry* entry = type < HANDLER_TABLE_SIZE ? &handlers_[type] : nullptr;
+    if (entry && entry->deadlineNs > 0 && entry->sheddable && message.getArrivalNs() > 0 &&
+        startNs - message.getArrivalNs() > entry->deadlineNs) {
+        // Nobody is waiting for the result any more
+        metrics.expired[slot]->add();
         return;
     }
 
-    LoginRequest req;
-    std::memcpy(&req, body.data(), sizeof(LoginRequest));
+    if (entry && entry->handler) {
+        entry->handler(session, message);
+    } else {
+        LOG_ERROR << "Unknown message type: " << type;
+    }
+
+    metrics.messages[slot]->add();
+    metrics.dispatchTime[slot]->record(metricsNowNs() - startNs);
+}
 
-    std::string username(req.username);
-    std::string password(req.password);
+void MessageDispatcher::handleLoginRequest(const SessionPtr& session,
+                                           const LoginRequest& req) {
+    // The fields need not be NUL terminated
+    std::string username(req.username, strnlen(req.username, sizeof(req.username)));
+    std::string password(req.password, strnlen(req.password, sizeof(req.password)));
 
-    std::cout << "Login request from fd=" << session->getFd()
-              << ", username=" << username << std::endl;
+    LOG_INFO << "Login request from fd=" << session->getFd()
+             << ", username=" << username;
 
     // Simple authentication (in real system, check against database)
     bool success = !username.empty() && !password.empty();
 
+    // Index the username, subject to the duplicate login policy
+    bool duplicate = false;
+    if (success && !sessionMgr_->bindUsername(session, username)) {
+        success = false;
+        duplicate = true;
+    }
+
     LoginResponse resp;
+    std::memset(&resp, 0, sizeof(resp));
     resp.success = success ? 1 : 0;
     if (success) {
-        session->setAuthenticated(true);
-        session->setUsername(username);
-        session->updateHeartbeat();
+        heartbeatMgr_->updateHeartbeat(session);
         std::strncpy(resp.message, "Login successful", sizeof(resp.message) - 1);
-        std::cout << "User authenticated: " << username << std::endl;
+        LOG_INFO << "User authenticated: " << username;
+    } else if (duplicate) {
+        std::strncpy(resp.message, "User already logged in", sizeof(resp.message) - 1);
     } else {
         std::strncpy(resp.message, "Login failed", sizeof(resp.message) - 1);
     }
@@ -73,10 +158,21 @@ void MessageDispatcher::handleLoginRequest(SessionPtr session,
     session->sendMessage(header, reinterpret_cast<const char*>(&resp));
 }
 
-void MessageDispatcher::handleHeartbeat(SessionPtr session) {
+void MessageDispatcher::handleHeartbeatInline(const SessionPtr& session) {
+    // The login may still be queued on the strand, stay behind it
+    StrandPtr strand = session->getStrand();
+    if (!session->isAuthenticated() && strand) {
+        strand->post([this, session]() { handleHeartbeat(session); }, Priority::HIGH);
+        return;
+    }
+
+    handleHeartbeat(session);
+}
+
+void MessageDispatcher::handleHeartbeat(const SessionPtr& session) {
     if (!session->isAuthenticated()) {
-        std::cerr << "Heartbeat from unauthenticated session, fd=" 
-                  << session->getFd() << std::endl;
+        LOG_ERROR << "Heartbeat from unauthenticated session, fd=" 
+                  << session->getFd();
         return;
     }
 
@@ -88,28 +184,28 @@ void MessageDispatcher::handleHeartbeat(SessionPtr session) {
     header.bodyLength = 0;
     header.totalLength = sizeof(MessageHeader);
     
-    session->sendMessage(header);
+    // A control frame, nothing else the client waits for is ordered after it
+    session->sendUrgent(header);
 }
 
-void MessageDispatcher::handleDataMessage(SessionPtr session, 
-                                         const std::vector<char>& body) {
+void MessageDispatcher::handleDataMessage(const SessionPtr& session,
+                                          const Message& message) {
     if (!session->isAuthenticated()) {
-        std::cerr << "Data message from unauthenticated session, fd=" 
-                  << session->getFd() << std::endl;
+        LOG_ERROR << "Data message from unauthenticated session, fd=" 
+                  << session->getFd();
         return;
     }
 
-    std::string data(body.begin(), body.end());
-    std::cout << "Data from " << session->getUsername() 
-              << ": " << data << std::endl;
+    LOG_DEBUG << "Data from " << session->getUsername() << ": "
+              << LogBytes(message.getBody(), message.getBodyLength());
 
     // Echo back to sender
     MessageHeader header;
     header.type = static_cast<uint16_t>(MessageType::DATA);
-    header.bodyLength = body.size();
-    header.totalLength = sizeof(MessageHeader) + body.size();
+    header.bodyLength = message.getBodyLength();
+    header.totalLength = sizeof(MessageHeader) + message.getBodyLength();
 
-    session->sendMessage(header, body.data());
+    session->sendMessage(header, message.getBody());
 }
 
 } // namespace tcp_server
@@ -0,0 +1,285 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace tcp_server {
+
+Counter::Counter() {
+    for (auto& stripe : stripes_) {
+        stripe.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& stripe : stripes_) {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram()
+    : stripes_(new Stripe[HISTOGRAM_STRIPES]) {
+    for (size_t s = 0; s < HISTOGRAM_STRIPES; ++s) {
+        Stripe& stripe = stripes_[s];
+        stripe.count.store(0, std::memory_order_relaxed);
+        stripe.sum.store(0, std::memory_order_relaxed);
+        stripe.max.store(0, std::memory_order_relaxed);
+        for (auto& bucket : stripe.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t Histogram::bucketIndex(uint64_t value) {
+    constexpr uint64_t subBuckets = 1ULL << HISTOGRAM_SUB_BUCKET_BITS;
+    if (value < subBuckets) {
+        return static_cast<size_t>(value);
+    }
+
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (msb >= HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+
+    // Position of the power of two, then the next 4 bits below the top one
+    unsigned shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    size_t sub = static_cast<size_t>((value >> shift) & (subBuckets - 1));
+    return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + sub;
+}
+
+uint64_t Histogram::bucketUpperBound(size_t index) {
+    constexpr size_t subBuckets = 1ULL << HISTOGRAM_SUB_BUCKET_BITS;
+    if (index < subBuckets) {
+        return index;
+    }
+
+    unsigned shift = static_cast<unsigned>(index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    uint64_t sub = index & (subBuckets - 1);
+    return ((subBuckets + sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    Stripe& stripe = stripes_[currentMetricStripe() % HISTOGRAM_STRIPES];
+    stripe.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    stripe.count.fetch_add(1, std::memory_order_relaxed);
+    stripe.sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = stripe.max.load(std::memory_order_relaxed);
+    while (value > max &&
+           !stripe.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::mergeBuckets(uint64_t* buckets) const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        uint64_t total = 0;
+        for (size_t s = 0; s < HISTOGRAM_STRIPES; ++s) {
+            total += stripes_[s].buckets[i].load(std::memory_order_relaxed);
+        }
+        buckets[i] = total;
+        count += total;
+    }
+    return count;
+}
+
+uint64_t Histogram::percentileOf(const uint64_t* buckets, uint64_t count, double q) {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count) + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucketUpperBound(i);
+        }
+    }
+    return bucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+uint64_t Histogram::percentile(double q) const {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count = mergeBuckets(buckets);
+    return percentileOf(buckets, count, q);
+}
+
+HistogramSummary Histogram::summarize() const {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count = mergeBuckets(buckets);
+
+    HistogramSummary summary;
+    summary.count = count;
+
+    uint64_t sum = 0;
+    for (size_t s = 0; s < HISTOGRAM_STRIPES; ++s) {
+        sum += stripes_[s].sum.load(std::memory_order_relaxed);
+        uint64_t max = stripes_[s].max.load(std::memory_order_relaxed);
+        if (max > summary.max) {
+            summary.max = max;
+        }
+    }
+
+    if (count > 0) {
+        summary.mean = sum / count;
+    }
+    // Bucket bounds may overshoot the largest value actually recorded
+    summary.p50 = std::min(percentileOf(buckets, count, 0.5), summary.max);
+    summary.p90 = std::min(percentileOf(buckets, count, 0.9), summary.max);
+    summary.p99 = std::min(percentileOf(buckets, count, 0.99), summary.max);
+    summary.p999 = std::min(percentileOf(buckets, count, 0.999), summary.max);
+    return summary;
+}
+
+std::string MetricsSnapshot::toString() const {
+    std::string out;
+    char line[256];
+
+    for (const auto& counter : counters) {
+        snprintf(line, sizeof(line), "%s %llu\n", counter.first.c_str(),
+                 static_cast<unsigned long long>(counter.second));
+        out += line;
+    }
+
+    for (const auto& gauge : gauges) {
+        snprintf(line, sizeof(line), "%s %llu\n", gauge.first.c_str(),
+                 static_cast<unsigned long long>(gauge.second));
+        out += line;
+    }
+
+    for (const auto& h : histograms) {
+        snprintf(line, sizeof(line),
+                 "%s count=%llu mean=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu\n",
+                 h.name.c_str(),
+                 static_cast<unsigned long long>(h.count),
+                 static_cast<unsigned long long>(h.mean),
+                 static_cast<unsigned long long>(h.p50),
+                 static_cast<unsigned long long>(h.p90),
+                 static_cast<unsigned long long>(h.p99),
+                 static_cast<unsigned long long>(h.p999),
+                 static_cast<unsigned long long>(h.max));
+        out += line;
+    }
+
+    return out;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    // Leaked, metrics may be recorded during static destruction
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : counters_) {
+        if (entry.first == name) {
+            return *entry.second;
+        }
+    }
+    counters_.emplace_back(name, std::unique_ptr<Counter>(new Counter()));
+    return *counters_.back().second;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : histograms_) {
+        if (entry.first == name) {
+            return *entry.second;
+        }
+    }
+    histograms_.emplace_back(name, std::unique_ptr<Histogram>(new Histogram()));
+    return *histograms_.back().second;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+    MetricsSnapshot snapshot;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& entry : counters_) {
+        snapshot.counters.emplace_back(entry.first, entry.second->value());
+    }
+
+    for (const auto& entry : histograms_) {
+        HistogramSummary summary = entry.second->summarize();
+        summary.name = entry.first;
+        snapshot.histograms.push_back(summary);
+    }
+
+    return snapshot;
+}
+
+namespace {
+
+const char* messageTypeName(size_t slot) {
+    switch (static_cast<MessageType>(slot)) {
+        case MessageType::LOGIN_REQUEST:  return "login_request";
+        case MessageType::LOGIN_RESPONSE: return "login_response";
+        case MessageType::HEARTBEAT:      return "heartbeat";
+        case MessageType::DATA:           return "data";
+        case MessageType::BROADCAST:      return "broadcast";
+        default:                          return "other";
+    }
+}
+
+const char* validationResultName(size_t slot) {
+    switch (static_cast<HeaderValidationResult>(slot)) {
+        case HeaderValidationResult::VALID:                return "valid";
+        case HeaderValidationResult::INVALID_MAGIC:        return "invalid_magic";
+        case HeaderValidationResult::INVALID_TYPE:         return "invalid_type";
+        case HeaderValidationResult::INVALID_TOTAL_LENGTH: return "invalid_total_length";
+        case HeaderValidationResult::INVALID_BODY_LENGTH:  return "invalid_body_length";
+        case HeaderValidationResult::LENGTH_MISMATCH:      return "length_mismatch";
+        default:                                           return "unknown";
+    }
+}
+
+} // namespace
+
+ServerMetrics& ServerMetrics::get() {
+    static ServerMetrics* metrics = new ServerMetrics();
+    return *metrics;
+}
+
+ServerMetrics::ServerMetrics() {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+
+    bytesIn = &registry.counter("bytes_in");
+    bytesOut = &registry.counter("bytes_out");
+
+    for (size_t i = 0; i < MESSAGE_TYPE_SLOTS; ++i) {
+        messages[i] = &registry.counter(std::string("messages.") + messageTypeName(i));
+        expired[i] = &registry.counter(std::string("expired.") + messageTypeName(i));
+        shed[i] = &registry.counter(std::string("shed.") + messageTypeName(i));
+    }
+
+    // VALID is never a failure, skip it in the registry
+    validationFailures[0] = nullptr;
+    for (size_t i = 1; i < VALIDATION_RESULT_SLOTS; ++i) {
+        validationFailures[i] = &registry.counter(
+            std::string("header_errors.") + validationResultName(i));
+    }
+
+    sendStalls = &registry.counter("send_stalls");
+    readPauses = &registry.counter("backpressure_pauses");
+    deferrals = &registry.counter("admission_deferrals");
+
+    queueWait = &registry.histogram("queue_wait_ns");
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+        queueWaitByPriority[i] = &registry.histogram(
+            std::string("queue_wait_ns.") + priorityName(static_cast<Priority>(i)));
+    }
+    for (size_t i = 0; i < MESSAGE_TYPE_SLOTS; ++i) {
+        dispatchTime[i] = &registry.histogram(
+            std::string("dispatch_ns.") + messageTypeName(i));
+    }
+    sendStallTime = &registry.histogram("send_stall_ns");
+}
+
+} // namespace tcp_server
@@ -0,0 +1,99 @@
+#include "ObjectPool.h"
+
+namespace tcp_server {
+
+namespace {
+
+// Every pool ever created, pools are leaked so the pointers stay valid
+std::mutex& registryMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+std::vector<FixedSizePool*>& registry() {
+    static std::vector<FixedSizePool*>* pools = new std::vector<FixedSizePool*>();
+    return *pools;
+}
+
+} // namespace
+
+FixedSizePool::FixedSizePool(const std::string& name, size_t objectSize,
+                             size_t objectsPerSlab)
+    : name_(name)
+    , objectSize_(objectSize)
+    , objectsPerSlab_(objectsPerSlab)
+    , freeList_(nullptr)
+    , freeCount_(0)
+    , allocations_(0) {
+    // Room for the free list link, and keep every slot max-aligned
+    constexpr size_t align = alignof(std::max_align_t);
+    if (objectSize_ < sizeof(FreeNode)) {
+        objectSize_ = sizeof(FreeNode);
+    }
+    objectSize_ = (objectSize_ + align - 1) & ~(align - 1);
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+}
+
+void* FixedSizePool::allocate() {
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!freeList_) {
+        addSlab();
+    }
+
+    FreeNode* node = freeList_;
+    freeList_ = node->next;
+    --freeCount_;
+    return node;
+}
+
+void FixedSizePool::deallocate(void* p) {
+    FreeNode* node = static_cast<FreeNode*>(p);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    node->next = freeList_;
+    freeList_ = node;
+    ++freeCount_;
+}
+
+void FixedSizePool::addSlab() {
+    // new char[] is max-aligned, which the slot size preserves
+    std::unique_ptr<char[]> slab(new char[objectSize_ * objectsPerSlab_]);
+    char* base = slab.get();
+
+    // Thread back to front so objects are handed out in address order
+    for (size_t i = objectsPerSlab_; i > 0; --i) {
+        FreeNode* node = reinterpret_cast<FreeNode*>(base + (i - 1) * objectSize_);
+        node->next = freeList_;
+        freeList_ = node;
+    }
+    freeCount_ += objectsPerSlab_;
+    slabs_.push_back(std::move(slab));
+}
+
+ObjectPoolStats FixedSizePool::getStats() const {
+    ObjectPoolStats stats;
+    stats.name = name_;
+    stats.objectSize = objectSize_;
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.slabs = slabs_.size();
+    stats.free = freeCount_;
+    stats.inUse = slabs_.size() * objectsPerSlab_ - freeCount_;
+    return stats;
+}
+
+std::vector<ObjectPoolStats> FixedSizePool::collectStats() {
+    std::vector<ObjectPoolStats> stats;
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (FixedSizePool* pool : registry()) {
+        stats.push_back(pool->getStats());
+    }
+    return stats;
+}
+
+} // namespace tcp_server
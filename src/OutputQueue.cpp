@@ -0,0 +1,215 @@
+#include "OutputQueue.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstring>
+
+namespace tcp_server {
+
+OutputQueue::OutputQueue()
+    : planSpans_(0)
+    , urgentRun_(0)
+    , tailUsed_(0)
+    , bytes_(0) {
+}
+
+void OutputQueue::append(const char* data, size_t len, bool urgent) {
+    Lane& lane = laneFor(urgent);
+    lane.open += len;
+    bytes_ += len;
+
+    while (len > 0) {
+        if (!tailBlock_ || tailUsed_ == tailBlock_->capacity()) {
+            tailBlock_ = BufferPool::defaultPool().acquire(len);
+            tailUsed_ = 0;
+        }
+
+        size_t n = tailBlock_->capacity() - tailUsed_;
+        if (n > len) {
+            n = len;
+        }
+
+        char* dest = tailBlock_->data() + tailUsed_;
+        std::memcpy(dest, data, n);
+
+        // Extend the last segment when the bytes are contiguous with it
+        if (!lane.segments.empty() && lane.segments.back().block.get() == tailBlock_.get() &&
+            lane.segments.back().data + lane.segments.back().len == dest) {
+            lane.segments.back().len += n;
+        } else {
+            Segment segment;
+            segment.block = tailBlock_;
+            segment.data = dest;
+            segment.len = n;
+            lane.segments.push_back(std::move(segment));
+        }
+
+        tailUsed_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void OutputQueue::append(const BufferRef& block, const char* data, size_t len, bool urgent) {
+    if (len == 0) {
+        return;
+    }
+
+    Lane& lane = laneFor(urgent);
+    Segment segment;
+    segment.block = block;
+    segment.data = data;
+    segment.len = len;
+    lane.segments.push_back(std::move(segment));
+    lane.open += len;
+    bytes_ += len;
+}
+
+void OutputQueue::endMessage(bool urgent, bool started) {
+    Lane& lane = laneFor(urgent);
+    if (lane.open == 0) {
+        return;
+    }
+    lane.messages.push_back(lane.open);
+    lane.open = 0;
+    if (started && lane.messages.size() == 1) {
+        lane.started = true;
+    }
+}
+
+ssize_t OutputQueue::writeTo(int fd) {
+    if (bytes_ == 0) {
+        return 0;
+    }
+
+    struct iovec iov[MAX_IOV_PER_WRITE];
+    size_t iovCount = fillIovecs(iov, MAX_IOV_PER_WRITE);
+
+    // sendmsg() rather than writev() so MSG_NOSIGNAL applies
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+
+    ssize_t sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (sent > 0) {
+        consume(static_cast<size_t>(sent));
+    }
+    return sent;
+}
+
+OutputQueue::Lane* OutputQueue::leadLane() {
+    // A message already on the wire is finished first
+    if (normal_.started) {
+        return &normal_;
+    }
+    if (urgent_.started) {
+        return &urgent_;
+    }
+    // Urgent bytes had their run, one normal message goes next
+    if (urgentRun_ >= MAX_URGENT_RUN_BYTES && !normal_.messages.empty()) {
+        return &normal_;
+    }
+    return nullptr;
+}
+
+size_t OutputQueue::fillLane(const Lane& lane, size_t skip, size_t limit,
+                             struct iovec* iov, size_t maxIov, size_t& iovCount) {
+    size_t bytes = 0;
+    for (auto it = lane.segments.begin();
+         it != lane.segments.end() && bytes < limit && iovCount < maxIov; ++it) {
+        if (skip >= it->len) {
+            skip -= it->len;
+            continue;
+        }
+        size_t len = std::min(it->len - skip, limit - bytes);
+        iov[iovCount].iov_base = const_cast<char*>(it->data + skip);
+        iov[iovCount].iov_len = len;
+        ++iovCount;
+        bytes += len;
+        skip = 0;
+    }
+    return bytes;
+}
+
+size_t OutputQueue::fillIovecs(struct iovec* iov, size_t maxIov) {
+    // Order: the front message of the lead lane, then urgent, then normal
+    size_t iovCount = 0;
+    size_t urgentSkip = 0;
+    size_t normalSkip = 0;
+    planSpans_ = 0;
+
+    Lane* lead = leadLane();
+    if (lead && !lead->messages.empty()) {
+        size_t bytes = fillLane(*lead, 0, lead->messages.front(), iov, maxIov, iovCount);
+        plan_[planSpans_++] = Span{lead, bytes};
+        (lead == &urgent_ ? urgentSkip : normalSkip) = bytes;
+    }
+
+    size_t bytes = fillLane(urgent_, urgentSkip, SIZE_MAX, iov, maxIov, iovCount);
+    plan_[planSpans_++] = Span{&urgent_, bytes};
+    bytes = fillLane(normal_, normalSkip, SIZE_MAX, iov, maxIov, iovCount);
+    plan_[planSpans_++] = Span{&normal_, bytes};
+    return iovCount;
+}
+
+void OutputQueue::consume(size_t len) {
+    bytes_ -= len;
+
+    for (size_t i = 0; i < planSpans_ && len > 0; ++i) {
+        size_t n = std::min(len, plan_[i].bytes);
+        if (plan_[i].lane == &urgent_ && !normal_.messages.empty()) {
+            urgentRun_ += n;
+        }
+        consumeLane(*plan_[i].lane, n);
+        len -= n;
+    }
+    planSpans_ = 0;
+
+    if (bytes_ == 0) {
+        // Give the packing block back to the pool while idle
+        tailBlock_.reset();
+        tailUsed_ = 0;
+        urgentRun_ = 0;
+    }
+}
+
+void OutputQueue::consumeLane(Lane& lane, size_t len) {
+    for (size_t left = len; left > 0;) {
+        Segment& front = lane.segments.front();
+        if (front.len > left) {
+            front.data += left;
+            front.len -= left;
+            break;
+        }
+        left -= front.len;
+        lane.segments.pop_front();
+    }
+
+    while (len > 0 && !lane.messages.empty()) {
+        size_t& front = lane.messages.front();
+        if (front > len) {
+            front -= len;
+            lane.started = true;
+            return;
+        }
+        len -= front;
+        lane.messages.pop_front();
+        lane.started = false;
+        if (&lane == &normal_) {
+            urgentRun_ = 0;
+        }
+    }
+}
+
+void OutputQueue::clear() {
+    urgent_ = Lane();
+    normal_ = Lane();
+    planSpans_ = 0;
+    urgentRun_ = 0;
+    tailBlock_.reset();
+    tailUsed_ = 0;
+    bytes_ = 0;
+}
+
+} // namespace tcp_server
@@ -1,65 +1,113 @@
 #include "PacketBuffer.h"
 #include <cstring>
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
 
 namespace tcp_server {
 
-PacketBuffer::PacketBuffer() {
-    buffer_.reserve(4096);
+PacketBuffer::PacketBuffer()
+    : readPos_(0)
+    , writePos_(0) {
+    // The block is acquired lazily on the first receive
 }
 
 void PacketBuffer::append(const char* data, size_t len) {
-    buffer_.insert(buffer_.end(), data, data + len);
+    ensureWritable(len);
+    std::memcpy(writeBegin(), data, len);
+    hasWritten(len);
 }
 
-bool PacketBuffer::extractMessage(MessageHeader& header, std::vector<char>& body) {
+void PacketBuffer::ensureWritable(size_t len) {
+    if (writableBytes() >= len) {
+        return;
+    }
+
+    size_t readable = size();
+
+    if (block_ && !block_->isShared() && readPos_ + writableBytes() >= len) {
+        // Enough room in total and nobody references the block,
+        // slide unread bytes to the front
+        std::memmove(block_->data(), readBegin(), readable);
+    } else {
+        // Move the unread bytes to a new block. The old one stays alive
+        // for as long as extracted messages reference it.
+        size_t newSize = readable + len;
+        if (block_ && !block_->isShared() && newSize < block_->capacity() * 2) {
+            newSize = block_->capacity() * 2;
+        }
+        BufferRef newBlock = BufferPool::defaultPool().acquire(newSize);
+        if (readable > 0) {
+            std::memcpy(newBlock->data(), readBegin(), readable);
+        }
+        block_ = newBlock;
+    }
+
+    readPos_ = 0;
+    writePos_ = readable;
+}
+
+void PacketBuffer::retrieve(size_t len) {
+    readPos_ += len;
+    if (readPos_ == writePos_ && !block_->isShared()) {
+        // Fully consumed and unreferenced, rewind for free. Otherwise keep
+        // appending at the tail, which never touches referenced bytes.
+        readPos_ = 0;
+        writePos_ = 0;
+    }
+}
+
+bool PacketBuffer::extractMessage(Message& message) {
     // Need at least header size
-    if (buffer_.size() < sizeof(MessageHeader)) {
+    if (size() < sizeof(MessageHeader)) {
         return false;
     }
 
     // Read header
-    std::memcpy(&header, buffer_.data(), sizeof(MessageHeader));
+    MessageHeader header;
+    std::memcpy(&header, readBegin(), sizeof(MessageHeader));
 
     // Validate header using the validation function
     auto validationResult = validateHeader(header);
     if (validationResult != HeaderValidationResult::VALID) {
-        std::cerr << "Header validation failed: " 
-                  << getValidationErrorMessage(validationResult) << std::endl;
-        std::cerr << "  Magic: 0x" << std::hex << header.magic << std::dec << std::endl;
-        std::cerr << "  Type: " << header.type << std::endl;
-        std::cerr << "  TotalLength: " << header.totalLength << std::endl;
-        std::cerr << "  BodyLength: " << header.bodyLength << std::endl;
+        ServerMetrics::get().validationFailures[
+            static_cast<size_t>(validationResult)]->add();
+        LOG_ERROR << "Header validation failed: " 
+                  << getValidationErrorMessage(validationResult)
+                  << ", magic=0x" << std::hex << header.magic << std::dec
+                  << ", type=" << header.type
+                  << ", totalLength=" << header.totalLength
+                  << ", bodyLength=" << header.bodyLength;
         
         // Clear buffer on validation error to prevent further issues
-        buffer_.clear();
+        clear();
         return false;
     }
 
     // Check if we have complete packet
-    if (buffer_.size() < header.totalLength) {
+    if (size() < header.totalLength) {
         // Not enough data yet, wait for more
         return false;
     }
 
-    // Extract body
+    // Reference the body in place, no copy
     if (header.bodyLength > 0) {
-        body.resize(header.bodyLength);
-        std::memcpy(body.data(), 
-                   buffer_.data() + sizeof(MessageHeader), 
-                   header.bodyLength);
+        message = Message(header, block_, readBegin() + sizeof(MessageHeader));
     } else {
-        body.clear();
+        message = Message(header, BufferRef(), nullptr);
     }
 
-    // Remove processed packet from buffer
-    buffer_.erase(buffer_.begin(), buffer_.begin() + header.totalLength);
+    // Consume processed packet by advancing the read cursor
+    retrieve(header.totalLength);
 
     return true;
 }
 
 void PacketBuffer::clear() {
-    buffer_.clear();
+    if (block_ && block_->isShared()) {
+        block_.reset();
+    }
+    readPos_ = 0;
+    writePos_ = 0;
 }
 
 } // namespace tcp_server
@@ -1,37 +1,121 @@
 #include "Server.h"
-#include <iostream>
+#include "Logger.h"
+#include "ObjectPool.h"
 #include <chrono>
 
 namespace tcp_server {
 
-Server::Server(int port, int heartbeatTimeout, size_t threadPoolSize)
-    : port_(port)
-    , running_(false) {
-    
-    epollServer_ = std::make_shared<EpollServer>(port);
+namespace {
+
+// "4k", "16k", ... "16m", "oversize" for blocks above every class
+std::string sizeClassName(size_t blockSize) {
+    if (blockSize == 0) {
+        return "oversize";
+    }
+    if (blockSize >= 1024 * 1024) {
+        return std::to_string(blockSize / (1024 * 1024)) + "m";
+    }
+    return std::to_string(blockSize / 1024) + "k";
+}
+
+ServerConfig makeConfig(int port, int heartbeatTimeout, size_t threadPoolSize,
+                        size_t reactorCount, SchedulerType schedulerType,
+                        IoBackend ioBackend) {
+    ServerConfig config;
+    config.loop.port = port;
+    config.heartbeatTimeoutSeconds = heartbeatTimeout;
+    config.pool.threadCount = threadPoolSize;
+    config.pool.scheduler = schedulerType;
+    config.reactorCount = reactorCount;
+    config.ioBackend = ioBackend;
+    return config;
+}
+
+} // namespace
+
+Server::Server(int port, int heartbeatTimeout, size_t threadPoolSize,
+               size_t reactorCount, SchedulerType schedulerType,
+               IoBackend ioBackend)
+    : Server(makeConfig(port, heartbeatTimeout, threadPoolSize, reactorCount,
+                        schedulerType, ioBackend)) {
+}
+
+Server::Server(const ServerConfig& config)
+    : config_(config)
+    , running_(false)
+    , stopRequested_(false) {
+
+    if (config_.reactorCount == 0) {
+        config_.reactorCount = 1;
+    }
+    size_t reactorCount = config_.reactorCount;
+
+    // Each reactor owns its epoll fd or ring, listen socket and session table
+    bool reusePort = reactorCount > 1;
+    for (size_t i = 0; i < reactorCount; ++i) {
+        reactors_.push_back(createEventLoop(config_.ioBackend, config_.loop,
+                                            static_cast<int>(i), reusePort));
+    }
+
     sessionMgr_ = std::make_shared<SessionManager>();
-    heartbeatMgr_ = std::make_shared<HeartbeatManager>(heartbeatTimeout);
+    sessionMgr_->setSessionReplacedCallback(
+        [this](SessionPtr session) { closeConnection(session); });
+    heartbeatMgr_ = std::make_shared<HeartbeatManager>(config_.heartbeatTimeoutSeconds);
     dispatcher_ = std::make_shared<MessageDispatcher>(sessionMgr_, heartbeatMgr_);
-    threadPool_ = std::make_shared<ThreadPool>(threadPoolSize);
+    for (const auto& deadline : config_.deadlinesMs) {
+        if (!dispatcher_->setDeadline(deadline.first,
+                                      std::chrono::milliseconds(deadline.second))) {
+            LOG_WARN << "Deadline of " << deadline.second << " ms for message type "
+                     << deadline.first << " not applied";
+        }
+    }
+
+    // Pauses happen on the reactor delivering the message, resumes come
+    // from workers and are handed to the owning reactor
+    flowController_ = std::make_shared<FlowController>(
+        [this](const SessionPtr& session) { getReactor(session)->pauseReading(session); },
+        [this](const SessionPtr& session) {
+            EventLoopPtr reactor = getReactor(session);
+            reactor->queueInLoop([this, reactor, session]() {
+                // Paused again while the resume was queued
+                if (!flowController_->isPaused(session)) {
+                    reactor->resumeReading(session);
+                }
+            });
+        });
+    flowController_->setConfig(config_.backpressure);
+    admission_ = std::make_shared<AdmissionController>(ServerMetrics::get().queueWait);
+    admission_->setConfig(config_.admission);
+    admission_->setOverloadEndedCallback([this]() { flowController_->endDeferral(); });
+    threadPool_ = createExecutor(config_.pool);
+    sessionMgr_->setFanoutExecutor(threadPool_);
 
-    std::cout << "Server initialized with thread pool size: " << threadPoolSize << std::endl;
+    LOG_INFO << "Server initialized with thread pool size: " << threadPool_->getThreadCount()
+             << ", reactors: " << reactorCount;
 
     // Set callbacks
-    epollServer_->setNewConnectionCallback(
-        [this](SessionPtr session) { onNewConnection(session); });
-    
-    epollServer_->setMessageCallback(
-        [this](SessionPtr session, const MessageHeader& header, 
-               const std::vector<char>& body) {
-            onMessage(session, header, body);
-        });
-    
-    epollServer_->setDisconnectCallback(
-        [this](int fd) { onDisconnect(fd); });
+    for (auto& reactor : reactors_) {
+        reactor->setNewConnectionCallback(
+            [this](SessionPtr session) { onNewConnection(session); });
+        
+        reactor->setMessageCallback(
+            [this](SessionPtr session, const Message& message) {
+                onMessage(session, message);
+            });
+        
+        reactor->setDisconnectCallback(
+            [this](const SessionPtr& session) { onDisconnect(session); });
+    }
 }
 
 Server::~Server() {
     stop();
+
+    // Join the workers while the members their tasks use are still alive;
+    // the session manager shares the pool for broadcast fan-out
+    sessionMgr_->setFanoutExecutor(nullptr);
+    threadPool_.reset();
+    dedicatedPool_.reset();
 }
 
 bool Server::start() {
@@ -39,17 +123,37 @@ bool Server::start() {
         return true;
     }
 
-    if (!epollServer_->start()) {
-        return false;
+    // Handlers are registered by now, the dedicated pool is only needed
+    // if one of them asked for it
+    if (!dedicatedPool_ && dispatcher_->usesPolicy(ExecutionPolicy::DEDICATED)) {
+        // Not pinned, the shared pool's workers already hold the chosen CPUs
+        dedicatedPool_ = createExecutor(config_.pool.scheduler, config_.dedicatedPoolSize);
+        LOG_INFO << "Dedicated handler pool with " << config_.dedicatedPoolSize << " threads";
     }
 
+    for (auto& reactor : reactors_) {
+        if (!reactor->start()) {
+            for (auto& started : reactors_) {
+                started->stop();
+            }
+            return false;
+        }
+    }
+
+    stopRequested_ = false;
     running_ = true;
 
+    // Reactor 0 is driven by run(), the rest get their own threads
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        EventLoopPtr reactor = reactors_[i];
+        reactorThreads_.emplace_back([this, reactor]() { reactorLoop(reactor); });
+    }
+
     // Start heartbeat check thread
-    heartbeatThread_ = std::make_unique<std::thread>(
-        [this]() { heartbeatCheckLoop(); });
+    heartbeatThread_.reset(new std::thread(
+        [this]() { heartbeatCheckLoop(); }));
 
-    std::cout << "Server started on port " << port_ << std::endl;
+    LOG_INFO << "Server started on port " << config_.loop.port;
     return true;
 }
 
@@ -60,29 +164,57 @@ void Server::stop() {
 
     running_ = false;
 
+    if (adminServer_) {
+        adminServer_->stop();
+    }
+
     if (heartbeatThread_ && heartbeatThread_->joinable()) {
         heartbeatThread_->join();
     }
 
-    epollServer_->stop();
-    std::cout << "Server stopped" << std::endl;
+    for (auto& reactor : reactors_) {
+        reactor->wakeup();
+    }
+
+    for (auto& thread : reactorThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    reactorThreads_.clear();
+
+    for (auto& reactor : reactors_) {
+        reactor->stop();
+    }
+    LOG_INFO << "Server stopped";
 }
 
 void Server::run() {
     if (!running_) {
-        std::cerr << "Server not started" << std::endl;
+        LOG_ERROR << "Server not started";
         return;
     }
 
-    std::cout << "Server running, press Ctrl+C to stop" << std::endl;
+    LOG_INFO << "Server running, press Ctrl+C to stop";
 
-    while (running_) {
-        epollServer_->runOnce(100);
+    reactorLoop(reactors_[0]);
+}
+
+void Server::requestStop() {
+    // Lock-free atomic store and an eventfd write, both safe in a signal
+    // handler; a signal landing on the loop thread also interrupts its wait
+    stopRequested_.store(true);
+    reactors_[0]->wakeup();
+}
+
+void Server::reactorLoop(EventLoopPtr reactor) {
+    while (running_ && !stopRequested_) {
+        reactor->runOnce(config_.loop.pollTimeoutMs);
     }
 }
 
-void Server::broadcast(const MessageHeader& header, const char* body) {
-    sessionMgr_->broadcast(header, body);
+BroadcastResult Server::broadcast(const MessageHeader& header, const char* body) {
+    return sessionMgr_->broadcast(header, body);
 }
 
 bool Server::sendToClient(int fd, const MessageHeader& header, const char* body) {
@@ -93,6 +225,31 @@ bool Server::sendToUser(const std::string& username, const MessageHeader& header
     return sessionMgr_->sendToUser(username, header, body);
 }
 
+void Server::setReadBudget(size_t bytes, size_t messages) {
+    config_.loop.readBudgetBytes = bytes;
+    config_.loop.readBudgetMessages = messages;
+    for (auto& reactor : reactors_) {
+        reactor->setReadBudget(bytes, messages);
+    }
+}
+
+void Server::setBackpressureConfig(const BackpressureConfig& config) {
+    config_.backpressure = config;
+    flowController_->setConfig(config);
+}
+
+void Server::setAdmissionConfig(const AdmissionConfig& config) {
+    config_.admission = config;
+    admission_->setConfig(config);
+}
+
+void Server::setWriteCoalescing(bool enable) {
+    config_.loop.writeCoalescing = enable;
+    for (auto& reactor : reactors_) {
+        reactor->setWriteCoalescing(enable);
+    }
+}
+
 size_t Server::getSessionCount() const {
     return sessionMgr_->getSessionCount();
 }
@@ -101,50 +258,195 @@ size_t Server::getPendingTaskCount() const {
     return threadPool_->getPendingTaskCount();
 }
 
+MetricsSnapshot Server::getMetricsSnapshot() const {
+    MetricsSnapshot snapshot = MetricsRegistry::instance().snapshot();
+
+    snapshot.gauges.emplace_back("sessions", sessionMgr_->getSessionCount());
+    snapshot.gauges.emplace_back("heartbeat_tracked", heartbeatMgr_->getTrackedCount());
+    snapshot.gauges.emplace_back("pending_tasks", threadPool_->getPendingTaskCount());
+    snapshot.gauges.emplace_back("buffer_pool_free_blocks",
+                                 BufferPool::defaultPool().getFreeBlockCount());
+    snapshot.gauges.emplace_back("log_dropped", Logger::instance().getDroppedCount());
+    snapshot.gauges.emplace_back("inbound_queued_tasks", flowController_->getQueuedTasks());
+    snapshot.gauges.emplace_back("inbound_queued_bytes", flowController_->getQueuedBytes());
+    snapshot.gauges.emplace_back("read_paused_sessions", flowController_->getPausedCount());
+    snapshot.gauges.emplace_back("admission_overloaded", admission_->isOverloaded() ? 1 : 0);
+    snapshot.gauges.emplace_back("queue_wait_window_p99_ns", admission_->getQueueWaitP99());
+
+    // Allocator usage, for sizing the pools
+    for (const auto& row : BufferPool::defaultPool().getStats()) {
+        std::string prefix = "buffer_pool." + sizeClassName(row.blockSize);
+        snapshot.gauges.emplace_back(prefix + ".free", row.freeBlocks);
+        snapshot.gauges.emplace_back(prefix + ".live", row.liveBlocks);
+        snapshot.gauges.emplace_back(prefix + ".acquires", row.acquires);
+        snapshot.gauges.emplace_back(prefix + ".misses", row.misses);
+    }
+    for (const auto& pool : FixedSizePool::collectStats()) {
+        std::string prefix = "object_pool." + pool.name;
+        snapshot.gauges.emplace_back(prefix + ".in_use", pool.inUse);
+        snapshot.gauges.emplace_back(prefix + ".free", pool.free);
+        snapshot.gauges.emplace_back(prefix + ".slabs", pool.slabs);
+        snapshot.gauges.emplace_back(prefix + ".allocations", pool.allocations);
+    }
+    return snapshot;
+}
+
+bool Server::startAdminSocket(const std::string& path) {
+    if (adminServer_) {
+        return true;
+    }
+
+    AdminServerPtr admin = std::make_shared<AdminServer>(
+        path, [this]() { return getMetricsSnapshot().toString(); });
+    if (!admin->start()) {
+        return false;
+    }
+    adminServer_ = admin;
+    return true;
+}
+
 void Server::onNewConnection(SessionPtr session) {
+    // Messages of one session run in order, different sessions in parallel
+    session->setStrand(Strand::create(threadPool_));
+    if (dedicatedPool_) {
+        session->setDedicatedStrand(Strand::create(dedicatedPool_));
+    }
     sessionMgr_->addSession(session);
 }
 
-void Server::onMessage(SessionPtr session, const MessageHeader& header,
-                       const std::vector<char>& body) {
-    // Submit message processing to thread pool
-    // We need to capture copies of the data to avoid race conditions
-    int fd = session->getFd();
-    
-    threadPool_->submit([this, session, header, body]() {
-        // Process the message in worker thread
-        try {
-            dispatcher_->dispatch(session, header, body);
-        } catch (const std::exception& e) {
-            std::cerr << "Exception processing message from fd=" << session->getFd()
-                     << ": " << e.what() << std::endl;
-        } catch (...) {
-            std::cerr << "Unknown exception processing message from fd=" 
-                     << session->getFd() << std::endl;
+void Server::onMessage(SessionPtr session, const Message& message) {
+    // The handler's policy picks the thread. Capturing the message only
+    // takes a reference on its receive buffer, the body is not copied.
+    uint16_t type = message.getHeader().type;
+    switch (dispatcher_->getPolicy(type)) {
+        case ExecutionPolicy::INLINE:
+            // Runs on the reactor, ahead of messages still queued on the strands
+            dispatchMessage(session, message);
+            break;
+
+        case ExecutionPolicy::POOL:
+            if (!admitMessage(session, message)) {
+                break;
+            }
+            // Counted until handled, may pause reading this session
+            flowController_->onQueued(session, message.getHeader().totalLength);
+            session->getStrand()->post([this, session, message]() {
+                dispatchMessage(session, message);
+                onTaskDone(session, message);
+            }, dispatcher_->getPriority(type));
+            break;
+
+        case ExecutionPolicy::DEDICATED: {
+            // No dedicated pool if the handler was registered after start()
+            StrandPtr strand = session->getDedicatedStrand();
+            if (!strand) {
+                strand = session->getStrand();
+            }
+            if (!admitMessage(session, message)) {
+                break;
+            }
+            flowController_->onQueued(session, message.getHeader().totalLength);
+            strand->post([this, session, message]() {
+                dispatchMessage(session, message);
+                onTaskDone(session, message);
+            }, dispatcher_->getPriority(type));
+            break;
         }
-    });
+    }
+}
+
+bool Server::admitMessage(const SessionPtr& session, const Message& message) {
+    uint16_t type = message.getHeader().type;
+    if (!dispatcher_->isSheddable(type)) {
+        return true;
+    }
+
+    refreshAdmission(message.getArrivalNs());
+    switch (admission_->admit()) {
+        case AdmissionAction::ADMIT:
+            return true;
+
+        case AdmissionAction::REJECT:
+            ServerMetrics::get().shed[ServerMetrics::typeSlot(type)]->add();
+            return false;
+
+        case AdmissionAction::DEFER:
+            // Queue this one, read nothing more from the session for now
+            flowController_->defer(session);
+            // The overload may have ended before the session was paused
+            if (!admission_->isOverloaded()) {
+                flowController_->endDeferral();
+            }
+            return true;
+    }
+    return true;
+}
+
+void Server::onTaskDone(const SessionPtr& session, const Message& message) {
+    flowController_->onDone(session, message.getHeader().totalLength);
+    // Deferred sessions send nothing, keep measuring while the queue drains
+    if (admission_->isOverloaded()) {
+        refreshAdmission(metricsNowNs());
+    }
 }
 
-void Server::onDisconnect(int fd) {
-    sessionMgr_->removeSession(fd);
+void Server::refreshAdmission(int64_t nowNs) {
+    // Nothing waits in an empty queue, whatever the last window says
+    if (flowController_->getQueuedTasks() == 0) {
+        admission_->onQueueDrained(nowNs);
+    } else {
+        admission_->refresh(nowNs);
+    }
+}
+
+void Server::dispatchMessage(const SessionPtr& session, const Message& message) {
+    try {
+        dispatcher_->dispatch(session, message);
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Exception processing message from fd=" << session->getFd()
+                 << ": " << e.what();
+    } catch (...) {
+        LOG_ERROR << "Unknown exception processing message from fd=" 
+                 << session->getFd();
+    }
+}
+
+void Server::onDisconnect(const SessionPtr& session) {
+    flowController_->removeSession(session);
+    heartbeatMgr_->removeSession(session);
+    sessionMgr_->removeSession(session);
 }
 
 void Server::heartbeatCheckLoop() {
     while (running_) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        // Get all sessions and check for timeouts
-        auto sessions = sessionMgr_->getAuthenticatedSessions();
-        auto timedOutFds = heartbeatMgr_->checkTimeouts(sessions);
+        // Advance the timing wheel, only expiring sessions are visited
+        auto timedOut = heartbeatMgr_->tick();
+
+        // Ends an overload even when no message arrives or completes
+        refreshAdmission(metricsNowNs());
 
         // Close timed out connections
-        // This will trigger EpollServer to close socket, remove from epoll,
+        // This will trigger the reactor to close the socket, drop it from its loop,
         // and call onDisconnect callback which removes from sessionMgr
-        for (int fd : timedOutFds) {
-            std::cout << "Heartbeat timeout, closing connection fd=" << fd << std::endl;
-            epollServer_->closeConnection(fd);
+        for (const auto& session : timedOut) {
+            LOG_INFO << "Heartbeat timeout, closing connection fd=" << session->getFd();
+            closeConnection(session);
         }
     }
 }
 
+EventLoopPtr Server::getReactor(const SessionPtr& session) const {
+    size_t reactorId = static_cast<size_t>(session->getReactorId());
+    return reactors_[reactorId < reactors_.size() ? reactorId : 0];
+}
+
+void Server::closeConnection(const SessionPtr& session) {
+    // Route the close to the reactor that owns the connection
+    if (session) {
+        getReactor(session)->closeConnection(session);
+    }
+}
+
 } // namespace tcp_server
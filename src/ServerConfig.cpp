@@ -0,0 +1,428 @@
+#include "ServerConfig.h"
+#include "Protocol.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace tcp_server {
+
+namespace {
+
+// Non-negative integer with an optional k / m / g (1024-based) suffix
+bool parseSize(const std::string& value, size_t& out) {
+    if (value.empty() || value[0] == '-') {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long n = std::strtoull(value.c_str(), &end, 10);
+    if (errno != 0 || end == value.c_str()) {
+        return false;
+    }
+
+    unsigned long long scale = 1;
+    if (*end == 'k' || *end == 'K') {
+        scale = 1024ULL;
+        ++end;
+    } else if (*end == 'm' || *end == 'M') {
+        scale = 1024ULL * 1024;
+        ++end;
+    } else if (*end == 'g' || *end == 'G') {
+        scale = 1024ULL * 1024 * 1024;
+        ++end;
+    }
+    if (*end != '\0' || n > SIZE_MAX / scale) {
+        return false;
+    }
+    out = static_cast<size_t>(n * scale);
+    return true;
+}
+
+bool parseInt(const std::string& value, int& out, int min, int max) {
+    errno = 0;
+    char* end = nullptr;
+    long n = std::strtol(value.c_str(), &end, 10);
+    if (errno != 0 || value.empty() || *end != '\0' || n < min || n > max) {
+        return false;
+    }
+    out = static_cast<int>(n);
+    return true;
+}
+
+bool parseCount(const std::string& value, size_t& out) {
+    size_t n = 0;
+    if (!parseSize(value, n) || n == 0) {
+        return false;
+    }
+    out = n;
+    return true;
+}
+
+// Socket buffer sizes go to setsockopt as int
+bool parseBufferSize(const std::string& value, int& out) {
+    size_t n = 0;
+    if (!parseSize(value, n) || n > static_cast<size_t>(INT_MAX)) {
+        return false;
+    }
+    out = static_cast<int>(n);
+    return true;
+}
+
+bool parseMsAsNs(const std::string& value, int64_t& out) {
+    size_t ms = 0;
+    if (!parseSize(value, ms) || ms > static_cast<size_t>(INT64_MAX / 1000000)) {
+        return false;
+    }
+    out = static_cast<int64_t>(ms) * 1000 * 1000;
+    return true;
+}
+
+bool parseBool(const std::string& value, bool& out) {
+    if (value == "on" || value == "true" || value == "yes" || value == "1") {
+        out = true;
+        return true;
+    }
+    if (value == "off" || value == "false" || value == "no" || value == "0") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseAdmissionAction(const std::string& value, AdmissionAction& out) {
+    if (value == "admit") {
+        out = AdmissionAction::ADMIT;
+    } else if (value == "reject") {
+        out = AdmissionAction::REJECT;
+    } else if (value == "defer") {
+        out = AdmissionAction::DEFER;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// "data", "broadcast" or a numeric type
+bool parseMessageType(const std::string& value, uint16_t& out) {
+    if (value == "data") {
+        out = static_cast<uint16_t>(MessageType::DATA);
+        return true;
+    }
+    if (value == "broadcast") {
+        out = static_cast<uint16_t>(MessageType::BROADCAST);
+        return true;
+    }
+    int type = 0;
+    if (!parseInt(value, type, 1, static_cast<int>(MessageType::MAX_MESSAGE_TYPE))) {
+        return false;
+    }
+    out = static_cast<uint16_t>(type);
+    return true;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+struct ConfigOption {
+    const char* name;
+    const char* help;
+    bool (*set)(ServerConfig& config, const std::string& value);
+};
+
+const ConfigOption OPTIONS[] = {
+    {"port", "listen port, 1-65535 (8888)",
+     [](ServerConfig& c, const std::string& v) { return parseInt(v, c.loop.port, 1, 65535); }},
+    {"reactors", "reactor threads sharing the port (1)",
+     [](ServerConfig& c, const std::string& v) { return parseCount(v, c.reactorCount); }},
+    {"io_backend", "epoll | uring (epoll)",
+     [](ServerConfig& c, const std::string& v) { return parseIoBackend(v.c_str(), c.ioBackend); }},
+    {"threads", "handler pool threads (4)",
+     [](ServerConfig& c, const std::string& v) { return parseCount(v, c.pool.threadCount); }},
+    {"scheduler", "queue | stealing (queue)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSchedulerType(v.c_str(), c.pool.scheduler);
+     }},
+    {"pool.first_cpu", "pin worker i to CPU first_cpu + i, -1 to not pin (-1)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.pool.firstCpu, -1, INT_MAX);
+     }},
+    {"pool.injection_capacity", "work-stealing injection queue slots (64k)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseCount(v, c.pool.injectionQueueCapacity);
+     }},
+    {"dedicated_threads", "DEDICATED handler pool threads (2)",
+     [](ServerConfig& c, const std::string& v) { return parseCount(v, c.dedicatedPoolSize); }},
+    {"heartbeat_timeout", "seconds without a heartbeat before a session is closed (10)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.heartbeatTimeoutSeconds, 1, 24 * 3600);
+     }},
+    {"log_level", "trace | debug | info | warn | error | off (info)",
+     [](ServerConfig& c, const std::string& v) { return parseLogLevel(v.c_str(), c.logLevel); }},
+    {"huge_pages", "back buffer pools with huge pages (off)",
+     [](ServerConfig& c, const std::string& v) { return parseBool(v, c.hugePages); }},
+    {"admin_socket", "metrics socket path ($XDG_RUNTIME_DIR or /tmp/tcp_server-<uid>, tcp_server_<port>.sock)",
+     [](ServerConfig& c, const std::string& v) {
+         c.adminSocketPath = v;
+         return !v.empty();
+     }},
+
+    {"socket.backlog", "listen backlog (128)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.loop.listenBacklog, 1, INT_MAX);
+     }},
+    {"socket.defer_accept", "TCP_DEFER_ACCEPT seconds, 0 off (0)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.loop.deferAcceptSeconds, 0, INT_MAX);
+     }},
+    {"socket.tcp_nodelay", "TCP_NODELAY on connections (off)",
+     [](ServerConfig& c, const std::string& v) { return parseBool(v, c.loop.tcpNoDelay); }},
+    {"socket.rcvbuf", "SO_RCVBUF bytes, 0 kernel default (0)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseBufferSize(v, c.loop.recvBufferBytes);
+     }},
+    {"socket.sndbuf", "SO_SNDBUF bytes, 0 kernel default (0)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseBufferSize(v, c.loop.sendBufferBytes);
+     }},
+    {"socket.busy_poll_us", "SO_BUSY_POLL and epoll busy poll microseconds, 0 off (0)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.loop.busyPollUs, 0, INT_MAX);
+     }},
+
+    {"loop.max_events", "events per epoll_wait (1024)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.loop.maxEvents, 1, INT_MAX);
+     }},
+    {"loop.recv_chunk", "bytes of free buffer per recv (4k)",
+     [](ServerConfig& c, const std::string& v) { return parseCount(v, c.loop.recvChunkBytes); }},
+    {"loop.poll_timeout_ms", "longest wait for events (100)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseInt(v, c.loop.pollTimeoutMs, 0, INT_MAX);
+     }},
+    {"loop.read_budget_bytes", "bytes read per connection per iteration (64k)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseCount(v, c.loop.readBudgetBytes);
+     }},
+    {"loop.read_budget_messages", "messages delivered per connection per iteration (64)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseCount(v, c.loop.readBudgetMessages);
+     }},
+    {"loop.write_coalescing", "one write per session per iteration, epoll (off)",
+     [](ServerConfig& c, const std::string& v) { return parseBool(v, c.loop.writeCoalescing); }},
+
+    {"backpressure.session_high_tasks", "0 no limit (1024)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.sessionHighTasks);
+     }},
+    {"backpressure.session_low_tasks", "(256)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.sessionLowTasks);
+     }},
+    {"backpressure.session_high_bytes", "0 no limit (16m)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.sessionHighBytes);
+     }},
+    {"backpressure.session_low_bytes", "(4m)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.sessionLowBytes);
+     }},
+    {"backpressure.global_high_tasks", "0 no limit (64k)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.globalHighTasks);
+     }},
+    {"backpressure.global_low_tasks", "(16k)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.globalLowTasks);
+     }},
+    {"backpressure.global_high_bytes", "0 no limit (256m)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.globalHighBytes);
+     }},
+    {"backpressure.global_low_bytes", "(64m)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseSize(v, c.backpressure.globalLowBytes);
+     }},
+
+    {"admission.p99_limit_ms", "queue wait p99 that counts as overload, 0 off (100)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseMsAsNs(v, c.admission.queueWaitP99LimitNs);
+     }},
+    {"admission.window_ms", "window of the queue wait p99 (100)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseMsAsNs(v, c.admission.windowNs) && c.admission.windowNs > 0;
+     }},
+    {"admission.action", "admit | reject | defer, for sheddable messages (defer)",
+     [](ServerConfig& c, const std::string& v) {
+         return parseAdmissionAction(v, c.admission.overloadAction);
+     }},
+};
+
+// "deadline.<type>" = ms, for data, broadcast or a numeric type
+bool setDeadlineOption(ServerConfig& config, const std::string& type,
+                       const std::string& value) {
+    uint16_t messageType = 0;
+    size_t ms = 0;
+    if (!parseMessageType(type, messageType) || !parseSize(value, ms)) {
+        return false;
+    }
+    // Logins and heartbeats are never shed, a deadline would not apply
+    if (messageType == static_cast<uint16_t>(MessageType::LOGIN_REQUEST) ||
+        messageType == static_cast<uint16_t>(MessageType::HEARTBEAT)) {
+        return false;
+    }
+    if (ms == 0) {
+        config.deadlinesMs.erase(messageType);
+    } else {
+        config.deadlinesMs[messageType] = static_cast<int64_t>(ms);
+    }
+    return true;
+}
+
+// A low watermark must sit below its high one, or a paused session would
+// resume straight into the limit again. A high of 0 disables the limit.
+bool checkWatermarks(const char* name, size_t high, size_t low) {
+    if (high != 0 && low >= high) {
+        LOG_ERROR << "backpressure." << name << ": low watermark " << low
+                  << " must be below high watermark " << high;
+        return false;
+    }
+    return true;
+}
+
+bool validateServerConfig(const ServerConfig& config) {
+    const BackpressureConfig& bp = config.backpressure;
+    return checkWatermarks("session_*_tasks", bp.sessionHighTasks, bp.sessionLowTasks) &&
+           checkWatermarks("session_*_bytes", bp.sessionHighBytes, bp.sessionLowBytes) &&
+           checkWatermarks("global_*_tasks", bp.globalHighTasks, bp.globalLowTasks) &&
+           checkWatermarks("global_*_bytes", bp.globalHighBytes, bp.globalLowBytes);
+}
+
+} // namespace
+
+bool setServerConfigOption(ServerConfig& config, const std::string& name,
+                           const std::string& value) {
+    const std::string deadlinePrefix = "deadline.";
+    if (name.compare(0, deadlinePrefix.size(), deadlinePrefix) == 0) {
+        if (!setDeadlineOption(config, name.substr(deadlinePrefix.size()), value)) {
+            LOG_ERROR << "Invalid value for " << name << ": " << value;
+            return false;
+        }
+        return true;
+    }
+
+    for (const ConfigOption& option : OPTIONS) {
+        if (name == option.name) {
+            if (!option.set(config, value)) {
+                LOG_ERROR << "Invalid value for " << name << ": " << value;
+                return false;
+            }
+            return true;
+        }
+    }
+
+    LOG_ERROR << "Unknown option: " << name;
+    return false;
+}
+
+bool loadServerConfigFile(const std::string& path, ServerConfig& config) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG_ERROR << "Failed to open config file " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            LOG_ERROR << path << ":" << lineNumber << ": expected name = value";
+            return false;
+        }
+        if (!setServerConfigOption(config, trim(line.substr(0, eq)), trim(line.substr(eq + 1)))) {
+            LOG_ERROR << path << ":" << lineNumber << ": bad option";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseServerConfigArgs(int argc, char* argv[], ServerConfig& config) {
+    // Positional form kept from before the flags existed
+    static const char* const POSITIONAL[] = {
+        "port", "threads", "reactors", "scheduler", "log_level", "io_backend", "huge_pages"
+    };
+    const size_t positionalCount = sizeof(POSITIONAL) / sizeof(POSITIONAL[0]);
+
+    int i = 1;
+    for (size_t slot = 0; i < argc && std::strncmp(argv[i], "--", 2) != 0; ++i, ++slot) {
+        if (slot >= positionalCount) {
+            LOG_ERROR << "Unexpected argument: " << argv[i];
+            return false;
+        }
+        if (!setServerConfigOption(config, POSITIONAL[slot], argv[i])) {
+            return false;
+        }
+    }
+
+    for (; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            LOG_ERROR << "Expected --<name>=<value>, got: " << arg;
+            return false;
+        }
+
+        std::string name;
+        std::string value;
+        size_t eq = arg.find('=');
+        if (eq != std::string::npos) {
+            name = arg.substr(2, eq - 2);
+            value = arg.substr(eq + 1);
+        } else if (i + 1 < argc) {
+            name = arg.substr(2);
+            value = argv[++i];
+        } else {
+            LOG_ERROR << "Missing value for " << arg;
+            return false;
+        }
+
+        // Later flags override what the file set
+        bool ok = name == "config" ? loadServerConfigFile(value, config)
+                                   : setServerConfigOption(config, name, value);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // Checked once everything is applied, options may come in any order
+    return validateServerConfig(config);
+}
+
+void printServerConfigOptions(std::ostream& out) {
+    for (const ConfigOption& option : OPTIONS) {
+        out << "  --" << option.name << "=<value>  " << option.help << "\n";
+    }
+    out << "  --deadline.<data|broadcast|type>=<ms>  drop messages of that type queued"
+           " longer than ms, 0 off (off)\n";
+    out << "  --config=<file>  read name = value lines from file\n";
+}
+
+} // namespace tcp_server
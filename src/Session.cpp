@@ -1,51 +1,347 @@
 #include "Session.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
+#include "ObjectPool.h"
 
 namespace tcp_server {
 
+namespace {
+
+struct SessionPoolTag {
+    static const char* name() { return "session"; }
+};
+
+} // namespace
+
+SessionPtr Session::create(int fd) {
+    return std::allocate_shared<Session>(PoolAllocator<Session, SessionPoolTag>(), fd);
+}
+
 Session::Session(int fd)
     : fd_(fd)
+    , reactorId_(0)
     , authenticated_(false)
-    , lastHeartbeat_(std::chrono::steady_clock::now()) {
+    , lastHeartbeat_(std::chrono::steady_clock::now())
+    , writeArmed_(false)
+    , flushScheduled_(false)
+    , coalesceWrites_(false)
+    , closed_(false)
+    , asyncWriteInFlight_(false)
+    , readPaused_(false)
+    , stallStartNs_(0) {
+    username_[0] = '\0';
 }
 
 Session::~Session() {
-    // Note: fd_ is managed by EpollServer, not closed here
+    // Note: fd_ is managed by the reactor, not closed here
+}
+
+void Session::setReadPaused(bool paused) {
+    // Under sendMutex_ so the events passed on always agree with writeArmed_
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (readPaused_ == paused || closed_) {
+        readPaused_ = paused;
+        return;
+    }
+
+    readPaused_ = paused;
+    if (interestCb_) {
+        interestCb_(fd_, !paused, writeArmed_);
+    }
+}
+
+void Session::setUsername(const std::string& name) {
+    std::lock_guard<std::mutex> lock(identityMutex_);
+    size_t len = std::min(name.size(), sizeof(username_) - 1);
+    std::memcpy(username_, name.data(), len);
+    username_[len] = '\0';
+}
+
+bool Session::send(const char* data, size_t len, size_t* queuedBytes) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    bool ok = sendLocked(data, len, nullptr, 0, false);
+    if (queuedBytes) {
+        *queuedBytes = outQueue_.size();
+    }
+    return ok;
+}
+
+bool Session::sendMessage(const MessageHeader& header, const char* body,
+                          size_t* queuedBytes) {
+    return sendHeaderAndBody(header, body, queuedBytes, false);
 }
 
-bool Session::send(const char* data, size_t len) {
+bool Session::sendUrgent(const MessageHeader& header, const char* body,
+                         size_t* queuedBytes) {
+    return sendHeaderAndBody(header, body, queuedBytes, true);
+}
+
+bool Session::sendHeaderAndBody(const MessageHeader& header, const char* body,
+                                size_t* queuedBytes, bool urgent) {
+    // Hold the lock across header and body so concurrent senders
+    // cannot interleave their bytes on the socket
+    std::lock_guard<std::mutex> lock(sendMutex_);
+
+    size_t bodyLen = (body && header.bodyLength > 0) ? header.bodyLength : 0;
+    bool ok = sendLocked(reinterpret_cast<const char*>(&header), sizeof(header),
+                         body, bodyLen, urgent);
+
+    if (queuedBytes) {
+        *queuedBytes = outQueue_.size();
+    }
+    return ok;
+}
+
+bool Session::sendLocked(const char* header, size_t headerLen,
+                         const char* body, size_t bodyLen, bool urgent) {
+    if (closed_) {
+        return false;
+    }
+
+    size_t len = headerLen + bodyLen;
     size_t totalSent = 0;
-    while (totalSent < len) {
-        ssize_t sent = ::send(fd_, data + totalSent, len - totalSent, MSG_NOSIGNAL);
+
+    // Only write directly when nothing is queued, otherwise bytes would
+    // reorder. Coalescing mode always defers to the reactor's flush.
+    if (outQueue_.empty() && !coalesceWrites_) {
+        while (totalSent < len) {
+            struct iovec iov[2];
+            int iovCount = 0;
+            if (totalSent < headerLen) {
+                iov[iovCount].iov_base = const_cast<char*>(header + totalSent);
+                iov[iovCount].iov_len = headerLen - totalSent;
+                ++iovCount;
+            }
+            if (bodyLen > 0) {
+                size_t bodySent = totalSent > headerLen ? totalSent - headerLen : 0;
+                iov[iovCount].iov_base = const_cast<char*>(body + bodySent);
+                iov[iovCount].iov_len = bodyLen - bodySent;
+                ++iovCount;
+            }
+
+            // sendmsg() rather than writev() so MSG_NOSIGNAL applies
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovCount;
+
+            ssize_t sent = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                LOG_ERROR << "Send error: " << strerror(errno);
+                return false;
+            }
+            totalSent += sent;
+        }
+        ServerMetrics::get().bytesOut->add(totalSent);
+    }
+
+    if (totalSent == len) {
+        return true;
+    }
+
+    if (outQueue_.size() + len - totalSent > MAX_OUTPUT_BUFFER_SIZE) {
+        LOG_ERROR << "Output buffer overflow, fd=" << fd_;
+        return false;
+    }
+
+    // Queue whatever was not written
+    if (totalSent < headerLen) {
+        outQueue_.append(header + totalSent, headerLen - totalSent, urgent);
+        outQueue_.append(body, bodyLen, urgent);
+    } else {
+        size_t bodySent = totalSent - headerLen;
+        outQueue_.append(body + bodySent, bodyLen - bodySent, urgent);
+    }
+    outQueue_.endMessage(urgent, totalSent > 0);
+
+    scheduleWriteLocked();
+    return true;
+}
+
+bool Session::sendFrame(const BufferRef& frame, size_t len, size_t* queuedBytes) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    bool ok = sendFrameLocked(frame, len);
+    if (queuedBytes) {
+        *queuedBytes = outQueue_.size();
+    }
+    return ok;
+}
+
+bool Session::sendFrameLocked(const BufferRef& frame, size_t len) {
+    if (closed_) {
+        return false;
+    }
+
+    const char* data = frame->data();
+    size_t totalSent = 0;
+
+    if (outQueue_.empty() && !coalesceWrites_) {
+        while (totalSent < len) {
+            ssize_t sent = ::send(fd_, data + totalSent, len - totalSent, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                LOG_ERROR << "Send error: " << strerror(errno);
+                return false;
+            }
+            totalSent += sent;
+        }
+        ServerMetrics::get().bytesOut->add(totalSent);
+    }
+
+    if (totalSent == len) {
+        return true;
+    }
+
+    if (outQueue_.size() + len - totalSent > MAX_OUTPUT_BUFFER_SIZE) {
+        LOG_ERROR << "Output buffer overflow, fd=" << fd_;
+        return false;
+    }
+
+    // Reference the shared frame instead of copying it
+    outQueue_.append(frame, data + totalSent, len - totalSent);
+    outQueue_.endMessage(false, totalSent > 0);
+    scheduleWriteLocked();
+    return true;
+}
+
+void Session::scheduleWriteLocked() {
+    if (coalesceWrites_) {
+        // One flush per loop iteration picks up everything queued until then.
+        // While EPOLLOUT is armed the writable event does the flushing,
+        // while an async write is in flight its completion does.
+        if (!flushScheduled_ && !writeArmed_ && !asyncWriteInFlight_) {
+            flushScheduled_ = true;
+            if (flushRequestCb_) {
+                flushRequestCb_(fd_);
+            }
+        }
+    } else {
+        armWriteLocked();
+    }
+}
+
+void Session::armWriteLocked() {
+    // Let the reactor finish the write once the socket is writable
+    if (!writeArmed_) {
+        writeArmed_ = true;
+        stallStartNs_ = metricsNowNs();
+        ServerMetrics::get().sendStalls->add();
+        if (interestCb_) {
+            interestCb_(fd_, !readPaused_, true);
+        }
+    }
+}
+
+bool Session::flushOutput() {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    flushScheduled_ = false;
+    if (closed_) {
+        return false;
+    }
+    return writeLocked();
+}
+
+bool Session::writeLocked() {
+    ServerMetrics& metrics = ServerMetrics::get();
+
+    while (!outQueue_.empty()) {
+        ssize_t sent = outQueue_.writeTo(fd_);
         if (sent < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (errno == EINTR) {
                 continue;
             }
-            std::cerr << "Send error: " << strerror(errno) << std::endl;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Armed, the reactor calls us again when writable
+                armWriteLocked();
+                return true;
+            }
+            LOG_ERROR << "Send error: " << strerror(errno);
             return false;
         }
-        totalSent += sent;
+        metrics.bytesOut->add(sent);
     }
+
+    // Drained
+    if (writeArmed_) {
+        writeArmed_ = false;
+        metrics.sendStallTime->record(metricsNowNs() - stallStartNs_);
+        if (interestCb_) {
+            interestCb_(fd_, !readPaused_, false);
+        }
+    }
+
     return true;
 }
 
-bool Session::sendMessage(const MessageHeader& header, const char* body) {
-    // Send header
-    if (!send(reinterpret_cast<const char*>(&header), sizeof(header))) {
+size_t Session::prepareAsyncWrite(struct iovec* iov, size_t maxIov) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    flushScheduled_ = false;
+    if (closed_ || asyncWriteInFlight_ || outQueue_.empty()) {
+        return 0;
+    }
+
+    asyncWriteInFlight_ = true;
+    return outQueue_.fillIovecs(iov, maxIov);
+}
+
+bool Session::completeAsyncWrite(ssize_t result) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    asyncWriteInFlight_ = false;
+
+    if (closed_) {
+        // markClosed() left the queue alone while the kernel used it
+        outQueue_.clear();
         return false;
     }
 
-    // Send body if present
-    if (body && header.bodyLength > 0) {
-        if (!send(body, header.bodyLength)) {
-            return false;
+    if (result < 0) {
+        if (result == -EINTR || result == -EAGAIN) {
+            return true;
         }
+        LOG_ERROR << "Send error: " << strerror(static_cast<int>(-result));
+        return false;
     }
 
+    outQueue_.consume(static_cast<size_t>(result));
+    ServerMetrics::get().bytesOut->add(result);
     return true;
 }
 
+size_t Session::getPendingOutputBytes() const {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    return outQueue_.size();
+}
+
+bool Session::isClosed() const {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    return closed_;
+}
+
+void Session::markClosed() {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    closed_ = true;
+    if (!asyncWriteInFlight_) {
+        outQueue_.clear();
+    }
+    writeArmed_ = false;
+    flushScheduled_ = false;
+}
+
 } // namespace tcp_server
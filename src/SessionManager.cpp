@@ -1,68 +1,254 @@
 #include "SessionManager.h"
-#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include "Logger.h"
 
 namespace tcp_server {
 
+constexpr size_t SessionManager::SHARD_COUNT;
+
+// Sessions handled per broadcast work item
+constexpr size_t BROADCAST_SLICE_SIZE = 512;
+
+// A session with more pending output than this after a broadcast is slow
+constexpr size_t SLOW_SESSION_BYTES = 256 * 1024;
+
+namespace {
+
+// Shared state of one broadcast. Slices are claimed through an atomic
+// cursor by the caller and by helper tasks on the executor, so the
+// caller never depends on a free worker to finish.
+struct BroadcastFanout {
+    SessionManager::Snapshot snapshot;
+    BufferRef frame;
+    size_t frameLength;
+    size_t sliceCount;
+
+    std::atomic<size_t> nextSlice;
+    std::atomic<size_t> finishedSlices;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> dropped;
+    std::atomic<size_t> slow;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    BroadcastFanout()
+        : frameLength(0), sliceCount(0), nextSlice(0), finishedSlices(0)
+        , queued(0), dropped(0), slow(0) {}
+
+    void run() {
+        size_t slice;
+        while ((slice = nextSlice.fetch_add(1)) < sliceCount) {
+            sendSlice(slice);
+            if (finishedSlices.fetch_add(1) + 1 == sliceCount) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    void sendSlice(size_t slice) {
+        size_t begin = slice * BROADCAST_SLICE_SIZE;
+        size_t end = std::min(begin + BROADCAST_SLICE_SIZE, snapshot->size());
+        size_t sliceQueued = 0, sliceDropped = 0, sliceSlow = 0;
+
+        for (size_t i = begin; i < end; ++i) {
+            const SessionPtr& session = (*snapshot)[i];
+            if (!session->isAuthenticated()) {
+                continue;
+            }
+
+            size_t pending = 0;
+            if (session->sendFrame(frame, frameLength, &pending)) {
+                ++sliceQueued;
+                if (pending > SLOW_SESSION_BYTES) {
+                    ++sliceSlow;
+                }
+            } else {
+                ++sliceDropped;
+            }
+        }
+
+        queued += sliceQueued;
+        dropped += sliceDropped;
+        slow += sliceSlow;
+    }
+};
+
+} // namespace
+
+SessionManager::SessionManager(DuplicateLoginPolicy policy)
+    : sessionCount_(0)
+    , version_(0)
+    , snapshotVersion_(0)
+    , snapshot_(std::make_shared<const std::vector<SessionPtr>>())
+    , policy_(policy) {
+}
+
 void SessionManager::addSession(SessionPtr session) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_[session->getFd()] = session;
-    std::cout << "Session added, fd=" << session->getFd() 
-              << ", total sessions=" << sessions_.size() << std::endl;
+    SessionPtr stale;
+    Shard& shard = shardFor(session->getFd());
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        SessionPtr& slot = shard.sessions[session->getFd()];
+        stale.swap(slot);
+        slot = session;
+    }
+    ++version_;
+
+    if (stale) {
+        // The earlier connection on this fd was never removed; it is
+        // replaced, so the count stays the same
+        LOG_WARN << "Session replaced stale entry, fd=" << session->getFd();
+        std::string username = stale->getUsername();
+        if (!username.empty()) {
+            unindexUsername(username, stale);
+        }
+        return;
+    }
+
+    size_t total = ++sessionCount_;
+    LOG_INFO << "Session added, fd=" << session->getFd() 
+             << ", total sessions=" << total;
 }
 
-void SessionManager::removeSession(int fd) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = sessions_.find(fd);
-    if (it != sessions_.end()) {
-        std::cout << "Session removed, fd=" << fd;
-        if (it->second->isAuthenticated()) {
-            std::cout << ", user=" << it->second->getUsername();
+void SessionManager::removeSession(const SessionPtr& session) {
+    int fd = session->getFd();
+    std::string username = session->getUsername();
+    if (!username.empty()) {
+        unindexUsername(username, session);
+    }
+
+    Shard& shard = shardFor(fd);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(fd);
+        if (it == shard.sessions.end() || it->second != session) {
+            return;
         }
-        std::cout << ", remaining sessions=" << (sessions_.size() - 1) << std::endl;
-        sessions_.erase(it);
+        shard.sessions.erase(it);
+    }
+    size_t remaining = --sessionCount_;
+    ++version_;
+
+    LOG_INFO << "Session removed, fd=" << fd
+             << ", user=" << (session->isAuthenticated() ? username : std::string("-"))
+             << ", remaining sessions=" << remaining;
+}
+
+void SessionManager::unindexUsername(const std::string& username, 
+                                     const SessionPtr& session) {
+    // Drop the index entry only if it still points at this session
+    UserShard& userShard = userShardFor(username);
+    std::lock_guard<std::mutex> lock(userShard.mutex);
+    auto it = userShard.sessions.find(username);
+    if (it != userShard.sessions.end() && it->second == session) {
+        userShard.sessions.erase(it);
     }
 }
 
 SessionPtr SessionManager::getSession(int fd) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = sessions_.find(fd);
-    if (it != sessions_.end()) {
+    Shard& shard = shardFor(fd);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(fd);
+    if (it != shard.sessions.end()) {
         return it->second;
     }
     return nullptr;
 }
 
+SessionManager::Snapshot SessionManager::getSnapshot() {
+    uint64_t version = version_.load();
+    Snapshot snapshot = std::atomic_load(&snapshot_);
+
+    std::lock_guard<std::mutex> lock(snapshotMutex_);
+    if (snapshotVersion_ == version) {
+        return snapshot;
+    }
+
+    // Rebuild, visiting one shard at a time so lookups are barely delayed
+    auto sessions = std::make_shared<std::vector<SessionPtr>>();
+    sessions->reserve(sessionCount_.load());
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        for (const auto& pair : shard.sessions) {
+            sessions->push_back(pair.second);
+        }
+    }
+
+    snapshot = sessions;
+    std::atomic_store(&snapshot_, snapshot);
+    snapshotVersion_ = version;
+    return snapshot;
+}
+
 std::vector<SessionPtr> SessionManager::getAuthenticatedSessions() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    Snapshot snapshot = getSnapshot();
     std::vector<SessionPtr> result;
-    for (const auto& pair : sessions_) {
-        if (pair.second->isAuthenticated()) {
-            result.push_back(pair.second);
+    for (const auto& session : *snapshot) {
+        if (session->isAuthenticated()) {
+            result.push_back(session);
         }
     }
     return result;
 }
 
-void SessionManager::broadcast(const MessageHeader& header, const char* body) {
-    auto sessions = getAuthenticatedSessions();
-    std::cout << "Broadcasting to " << sessions.size() << " authenticated clients" << std::endl;
-    
-    for (const auto& session : sessions) {
-        if (!session->sendMessage(header, body)) {
-            std::cerr << "Failed to send to fd=" << session->getFd() << std::endl;
+BroadcastResult SessionManager::broadcast(const MessageHeader& header, const char* body) {
+    auto fanout = std::make_shared<BroadcastFanout>();
+    fanout->snapshot = getSnapshot();
+
+    // Encode the frame once, every session shares it
+    size_t bodyLength = (body && header.bodyLength > 0) ? header.bodyLength : 0;
+    fanout->frameLength = sizeof(MessageHeader) + bodyLength;
+    fanout->frame = BufferPool::defaultPool().acquire(fanout->frameLength);
+    std::memcpy(fanout->frame->data(), &header, sizeof(MessageHeader));
+    if (bodyLength > 0) {
+        std::memcpy(fanout->frame->data() + sizeof(MessageHeader), body, bodyLength);
+    }
+
+    fanout->sliceCount = (fanout->snapshot->size() + BROADCAST_SLICE_SIZE - 1) 
+                         / BROADCAST_SLICE_SIZE;
+
+    // Let idle workers take slices while this thread works on them too
+    if (fanoutExecutor_ && fanout->sliceCount > 1) {
+        size_t helpers = std::min(fanout->sliceCount - 1, 
+                                  fanoutExecutor_->getThreadCount());
+        for (size_t i = 0; i < helpers; ++i) {
+            fanoutExecutor_->submit([fanout]() { fanout->run(); });
         }
     }
+
+    fanout->run();
+
+    {
+        std::unique_lock<std::mutex> lock(fanout->mutex);
+        fanout->finished.wait(lock, [&fanout]() {
+            return fanout->finishedSlices.load() >= fanout->sliceCount;
+        });
+    }
+
+    BroadcastResult result;
+    result.queued = fanout->queued.load();
+    result.dropped = fanout->dropped.load();
+    result.slow = fanout->slow.load();
+
+    LOG_INFO << "Broadcast done: queued=" << result.queued
+             << ", dropped=" << result.dropped
+             << ", slow=" << result.slow;
+    return result;
 }
 
 bool SessionManager::sendToClient(int fd, const MessageHeader& header, const char* body) {
     auto session = getSession(fd);
     if (!session) {
-        std::cerr << "Session not found, fd=" << fd << std::endl;
+        LOG_ERROR << "Session not found, fd=" << fd;
         return false;
     }
 
     if (!session->isAuthenticated()) {
-        std::cerr << "Session not authenticated, fd=" << fd << std::endl;
+        LOG_ERROR << "Session not authenticated, fd=" << fd;
         return false;
     }
 
@@ -72,33 +258,73 @@ bool SessionManager::sendToClient(int fd, const MessageHeader& header, const cha
 bool SessionManager::sendToUser(const std::string& username, const MessageHeader& header, const char* body) {
     auto session = getSessionByUsername(username);
     if (!session) {
-        std::cerr << "User not found: " << username << std::endl;
+        LOG_ERROR << "User not found: " << username;
         return false;
     }
 
     if (!session->isAuthenticated()) {
-        std::cerr << "User not authenticated: " << username << std::endl;
+        LOG_ERROR << "User not authenticated: " << username;
         return false;
     }
 
-    std::cout << "Sending message to user: " << username << ", fd=" << session->getFd() << std::endl;
+    LOG_DEBUG << "Sending message to user: " << username << ", fd=" << session->getFd();
     return session->sendMessage(header, body);
 }
 
 SessionPtr SessionManager::getSessionByUsername(const std::string& username) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (const auto& pair : sessions_) {
-        if (pair.second->isAuthenticated() && 
-            pair.second->getUsername() == username) {
-            return pair.second;
-        }
+    UserShard& userShard = userShardFor(username);
+    std::lock_guard<std::mutex> lock(userShard.mutex);
+    auto it = userShard.sessions.find(username);
+    if (it != userShard.sessions.end()) {
+        return it->second;
     }
     return nullptr;
 }
 
-size_t SessionManager::getSessionCount() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return sessions_.size();
+bool SessionManager::bindUsername(SessionPtr session, const std::string& username) {
+    std::string previousName = session->getUsername();
+    SessionPtr replaced;
+    {
+        UserShard& userShard = userShardFor(username);
+        std::lock_guard<std::mutex> lock(userShard.mutex);
+        auto it = userShard.sessions.find(username);
+        if (it != userShard.sessions.end() && it->second != session) {
+            if (policy_ == DuplicateLoginPolicy::REJECT_NEW) {
+                LOG_ERROR << "Duplicate login rejected: " << username
+                          << ", fd=" << session->getFd();
+                return false;
+            }
+
+            // The old session loses its identity and gets kicked below
+            replaced = it->second;
+            replaced->setAuthenticated(false);
+        }
+
+        session->setUsername(username);
+        session->setAuthenticated(true);
+        userShard.sessions[username] = session;
+    }
+
+    // Re-login under another name releases the previous one
+    if (!previousName.empty() && previousName != username) {
+        unindexUsername(previousName, session);
+    }
+
+    // Lost a race with disconnect, do not leave a dangling index entry
+    if (session->isClosed()) {
+        unindexUsername(username, session);
+        return false;
+    }
+
+    if (replaced) {
+        LOG_INFO << "Duplicate login for " << username << ", replacing fd="
+                 << replaced->getFd() << " with fd=" << session->getFd();
+        if (sessionReplacedCb_) {
+            sessionReplacedCb_(replaced);
+        }
+    }
+
+    return true;
 }
 
 } // namespace tcp_server
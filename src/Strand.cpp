@@ -0,0 +1,99 @@
+#include "Strand.h"
+#include "Logger.h"
+#include "ObjectPool.h"
+
+namespace tcp_server {
+
+namespace {
+
+struct StrandPoolTag {
+    static const char* name() { return "strand"; }
+};
+
+} // namespace
+
+// Tasks run per pool submission before yielding the worker to other strands
+constexpr size_t MAX_TASKS_PER_RUN = 64;
+
+// Every session owns a strand and most have only a few messages in
+// flight, so start small and let the ring grow under load
+constexpr size_t INITIAL_TASK_CAPACITY = 4;
+
+StrandPtr Strand::create(ExecutorPtr pool) {
+    return std::allocate_shared<Strand>(PoolAllocator<Strand, StrandPoolTag>(), pool);
+}
+
+Strand::Strand(ExecutorPtr pool)
+    : pool_(pool)
+    , tasks_(INITIAL_TASK_CAPACITY)
+    , scheduled_(false) {
+}
+
+void Strand::post(Executor::Task task, Priority priority) {
+    bool idle = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(Entry(std::move(task), priority));
+        if (!scheduled_) {
+            scheduled_ = true;
+            idle = true;
+        }
+    }
+
+    if (idle) {
+        schedule(priority);
+    }
+}
+
+void Strand::schedule(Priority priority) {
+    auto self = shared_from_this();
+    pool_->submit([self, priority]() { self->run(priority); }, priority);
+}
+
+size_t Strand::getPendingTaskCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+void Strand::run(Priority priority) {
+    for (size_t i = 0; i < MAX_TASKS_PER_RUN; ++i) {
+        Executor::Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty()) {
+                scheduled_ = false;
+                return;
+            }
+            // Lower priority work waits its turn on the pool instead of
+            // riding along with a control message
+            if (tasks_.front().priority > priority) {
+                break;
+            }
+            task = std::move(tasks_.front().task);
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Exception in strand task: " << e.what();
+        } catch (...) {
+            LOG_ERROR << "Unknown exception in strand task";
+        }
+    }
+
+    // Still busy: requeue behind other work so one session cannot hog a
+    // worker, at the class of the task now in front
+    Priority next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            scheduled_ = false;
+            return;
+        }
+        next = tasks_.front().priority;
+    }
+    schedule(next);
+}
+
+} // namespace tcp_server
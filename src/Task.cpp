@@ -0,0 +1,68 @@
+#include "Task.h"
+#include <mutex>
+#include <vector>
+
+namespace tcp_server {
+
+constexpr size_t TaskSlab::CHUNK_SIZE;
+constexpr size_t Task::INLINE_CAPACITY;
+
+namespace {
+
+// Chunks carved per refill of the free list
+constexpr size_t CHUNKS_PER_SLAB = 64;
+
+union Chunk {
+    Chunk* next;
+    alignas(std::max_align_t) unsigned char bytes[TaskSlab::CHUNK_SIZE];
+};
+
+struct SlabState {
+    std::mutex mutex;
+    Chunk* freeList = nullptr;
+    std::vector<Chunk*> slabs;   // kept for the process lifetime
+};
+
+SlabState& slabState() {
+    // Intentionally leaked, tasks may be destroyed during static destruction
+    static SlabState* state = new SlabState();
+    return *state;
+}
+
+} // namespace
+
+void* TaskSlab::allocate(size_t size) {
+    if (size > CHUNK_SIZE) {
+        return ::operator new(size);
+    }
+
+    SlabState& state = slabState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.freeList) {
+        Chunk* slab = new Chunk[CHUNKS_PER_SLAB];
+        state.slabs.push_back(slab);
+        for (size_t i = 0; i < CHUNKS_PER_SLAB; ++i) {
+            slab[i].next = state.freeList;
+            state.freeList = &slab[i];
+        }
+    }
+
+    Chunk* chunk = state.freeList;
+    state.freeList = chunk->next;
+    return chunk;
+}
+
+void TaskSlab::deallocate(void* ptr, size_t size) {
+    if (size > CHUNK_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    SlabState& state = slabState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    Chunk* chunk = static_cast<Chunk*>(ptr);
+    chunk->next = state.freeList;
+    state.freeList = chunk;
+}
+
+} // namespace tcp_server
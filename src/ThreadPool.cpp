@@ -1,19 +1,24 @@
 #include "ThreadPool.h"
-#include <iostream>
+#include "Logger.h"
 
 namespace tcp_server {
 
 ThreadPool::ThreadPool(size_t threadCount)
-    : stopped_(false) {
-    
-    if (threadCount == 0) {
-        threadCount = 1;
-    }
+    : ThreadPool(executorConfig(SchedulerType::GLOBAL_QUEUE, threadCount)) {
+}
+
+ThreadPool::ThreadPool(const ExecutorConfig& config)
+    : queueWait_(ServerMetrics::get().queueWait)
+    , queueWaitByPriority_(ServerMetrics::get().queueWaitByPriority)
+    , stopped_(false) {
+
+    size_t threadCount = config.threadCount > 0 ? config.threadCount : 1;
 
-    std::cout << "Creating thread pool with " << threadCount << " threads" << std::endl;
+    LOG_INFO << "Creating thread pool with " << threadCount << " threads";
 
     for (size_t i = 0; i < threadCount; ++i) {
         threads_.emplace_back([this]() { workerThread(); });
+        pinWorkerThread(threads_.back(), config, i);
     }
 }
 
@@ -27,18 +32,18 @@ ThreadPool::~ThreadPool() {
         }
     }
 
-    std::cout << "Thread pool destroyed" << std::endl;
+    LOG_INFO << "Thread pool destroyed";
 }
 
-void ThreadPool::submit(Task task) {
+void ThreadPool::submit(Task task, Priority priority) {
     if (stopped_) {
-        std::cerr << "Cannot submit task to stopped thread pool" << std::endl;
+        LOG_ERROR << "Cannot submit task to stopped thread pool";
         return;
     }
 
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        tasks_.push(std::move(task));
+        tasks_.push(QueuedTask(std::move(task), metricsNowNs(), priority), priority);
     }
     
     condition_.notify_one();
@@ -63,9 +68,12 @@ void ThreadPool::workerThread() {
                 return;
             }
 
-            if (!tasks_.empty()) {
-                task = std::move(tasks_.front());
-                tasks_.pop();
+            QueuedTask queued;
+            if (tasks_.pop(queued)) {
+                int64_t waitNs = metricsNowNs() - queued.enqueuedNs;
+                queueWait_->record(waitNs);
+                queueWaitByPriority_[priorityIndex(queued.priority)]->record(waitNs);
+                task = std::move(queued.task);
             }
         }
 
@@ -73,9 +81,9 @@ void ThreadPool::workerThread() {
             try {
                 task();
             } catch (const std::exception& e) {
-                std::cerr << "Exception in thread pool task: " << e.what() << std::endl;
+                LOG_ERROR << "Exception in thread pool task: " << e.what();
             } catch (...) {
-                std::cerr << "Unknown exception in thread pool task" << std::endl;
+                LOG_ERROR << "Unknown exception in thread pool task";
             }
         }
     }
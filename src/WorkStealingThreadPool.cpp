@@ -0,0 +1,273 @@
+#include "WorkStealingThreadPool.h"
+#include <chrono>
+#include "Logger.h"
+
+namespace tcp_server {
+
+// Most tasks moved to the thief's deque in one steal
+constexpr size_t MAX_STEAL_BATCH = 32;
+
+// Upper bound on an idle worker's sleep, a safety net for missed wakeups
+constexpr int IDLE_WAIT_MS = 10;
+
+namespace {
+
+// Identifies the pool and worker index of the current thread
+thread_local WorkStealingThreadPool* currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+
+// MpmcQueue needs a power of two
+size_t injectionCapacity(size_t requested) {
+    size_t capacity = 1;
+    while (capacity < requested) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+} // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t threadCount)
+    : WorkStealingThreadPool(executorConfig(SchedulerType::WORK_STEALING, threadCount)) {
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(const ExecutorConfig& config)
+    : injected_(injectionCapacity(config.injectionQueueCapacity))
+    , overflowSize_(0)
+    , pending_(0)
+    , sleepers_(0)
+    , stopped_(false)
+    , queueWait_(ServerMetrics::get().queueWait)
+    , queueWaitByPriority_(ServerMetrics::get().queueWaitByPriority) {
+
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+        rankedCounts_[i].store(0);
+    }
+
+    size_t threadCount = config.threadCount > 0 ? config.threadCount : 1;
+
+    LOG_INFO << "Creating work-stealing thread pool with " << threadCount 
+             << " threads";
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+
+    // Start threads only after all deques exist, workers steal from each other
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_[i]->thread = std::thread([this, i]() { workerThread(i); });
+        pinWorkerThread(workers_[i]->thread, config, i);
+    }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    stopped_ = true;
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCondition_.notify_all();
+    }
+
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    LOG_INFO << "Thread pool destroyed";
+}
+
+void WorkStealingThreadPool::submit(Task task, Priority priority) {
+    if (stopped_) {
+        LOG_ERROR << "Cannot submit task to stopped thread pool";
+        return;
+    }
+
+    pending_.fetch_add(1);
+    QueuedTask queued(std::move(task), metricsNowNs(), priority);
+
+    if (priority != Priority::NORMAL) {
+        std::lock_guard<std::mutex> lock(rankedMutex_);
+        ranked_.push(std::move(queued), priority);
+        rankedCounts_[priorityIndex(priority)].fetch_add(1);
+    } else if (currentPool == this) {
+        // Submitted by one of our workers, keep it local
+        Worker& worker = *workers_[currentIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(queued));
+    } else if (!injected_.tryPush(queued)) {
+        std::lock_guard<std::mutex> lock(overflowMutex_);
+        overflow_.push_back(std::move(queued));
+        overflowSize_.fetch_add(1);
+    }
+
+    notifyIdleWorker();
+}
+
+void WorkStealingThreadPool::notifyIdleWorker() {
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCondition_.notify_one();
+    }
+}
+
+bool WorkStealingThreadPool::popNext(size_t index, QueuedTask& task) {
+    Worker& worker = *workers_[index];
+    bool lowWaiting = rankedCounts_[priorityIndex(Priority::LOW)].load() > 0;
+
+    // LOW work passed over too often goes first
+    if (worker.lowSkips >= MAX_PRIORITY_SKIPS && popRanked(Priority::LOW, task)) {
+        worker.lowSkips = 0;
+        return true;
+    }
+
+    // HIGH work goes ahead of NORMAL, up to MAX_PRIORITY_SKIPS in a row
+    if (worker.normalSkips < MAX_PRIORITY_SKIPS && popRanked(Priority::HIGH, task)) {
+        ++worker.normalSkips;
+        if (lowWaiting) {
+            ++worker.lowSkips;
+        }
+        return true;
+    }
+
+    // Strands requeue on the worker's own deque, so new sessions fed by the
+    // reactors would wait for it to run dry without a periodic look
+    bool found = (++worker.picks % MAX_PRIORITY_SKIPS == 0 && popInjected(task)) ||
+                 popLocal(index, task) || popInjected(task) || steal(index, task);
+    worker.normalSkips = 0;
+    if (found) {
+        if (lowWaiting) {
+            ++worker.lowSkips;
+        }
+        return true;
+    }
+
+    if (popRanked(Priority::HIGH, task)) {
+        return true;
+    }
+    if (popRanked(Priority::LOW, task)) {
+        worker.lowSkips = 0;
+        return true;
+    }
+    return false;
+}
+
+bool WorkStealingThreadPool::popRanked(Priority priority, QueuedTask& task) {
+    std::atomic<size_t>& count = rankedCounts_[priorityIndex(priority)];
+    if (count.load() == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(rankedMutex_);
+    if (!ranked_.pop(task, priority)) {
+        return false;
+    }
+    count.fetch_sub(1);
+    return true;
+}
+
+bool WorkStealingThreadPool::popLocal(size_t index, QueuedTask& task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingThreadPool::popInjected(QueuedTask& task) {
+    if (injected_.tryPop(task)) {
+        return true;
+    }
+
+    if (overflowSize_.load() == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    if (overflow_.empty()) {
+        return false;
+    }
+    task = std::move(overflow_.front());
+    overflow_.pop_front();
+    overflowSize_.fetch_sub(1);
+    return true;
+}
+
+bool WorkStealingThreadPool::steal(size_t index, QueuedTask& task) {
+    size_t count = workers_.size();
+    for (size_t offset = 1; offset < count; ++offset) {
+        Worker& victim = *workers_[(index + offset) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+
+        // Take the oldest task to run now, plus half of the rest
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+
+        size_t stealCount = victim.tasks.size() / 2;
+        if (stealCount > MAX_STEAL_BATCH) {
+            stealCount = MAX_STEAL_BATCH;
+        }
+        if (stealCount > 0) {
+            // Staged on the stack, never hold two worker locks at once
+            QueuedTask stolen[MAX_STEAL_BATCH];
+            for (size_t i = 0; i < stealCount; ++i) {
+                stolen[i] = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+            }
+            lock.unlock();
+
+            Worker& self = *workers_[index];
+            std::lock_guard<std::mutex> selfLock(self.mutex);
+            for (size_t i = stealCount; i > 0; --i) {
+                self.tasks.push_back(std::move(stolen[i - 1]));
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingThreadPool::workerThread(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    while (true) {
+        QueuedTask queued;
+
+        if (popNext(index, queued)) {
+            pending_.fetch_sub(1);
+            int64_t waitNs = metricsNowNs() - queued.enqueuedNs;
+            queueWait_->record(waitNs);
+            queueWaitByPriority_[priorityIndex(queued.priority)]->record(waitNs);
+            Task task(std::move(queued.task));
+
+            try {
+                task();
+            } catch (const std::exception& e) {
+                LOG_ERROR << "Exception in thread pool task: " << e.what();
+            } catch (...) {
+                LOG_ERROR << "Unknown exception in thread pool task";
+            }
+            continue;
+        }
+
+        if (stopped_) {
+            return;
+        }
+
+        // Nothing to do, sleep until a submit wakes us
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        sleepers_.fetch_add(1);
+        idleCondition_.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS), [this]() {
+            return stopped_ || pending_.load() > 0;
+        });
+        sleepers_.fetch_sub(1);
+    }
+}
+
+} // namespace tcp_server
@@ -1,6 +1,9 @@
 #include "Server.h"
+#include "ServerConfig.h"
+#include "Logger.h"
 #include <iostream>
 #include <csignal>
+#include <cstring>
 #include <memory>
 
 using namespace tcp_server;
@@ -8,56 +11,91 @@ using namespace tcp_server;
 std::unique_ptr<Server> g_server;
 
 void signalHandler(int signal) {
-    if (signal == SIGINT || signal == SIGTERM) {
-        std::cout << "\nReceived signal, shutting down..." << std::endl;
-        if (g_server) {
-            g_server->stop();
-        }
+    // Only async-signal-safe work here, main() stops the server once
+    // run() returns
+    if ((signal == SIGINT || signal == SIGTERM) && g_server) {
+        g_server->requestStop();
     }
 }
 
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [port] [thread_pool_size] [reactor_count] [scheduler]"
+              << " [log_level] [io_backend] [huge_pages] [--config=<file>] [--<option>=<value>...]"
+              << std::endl;
+    std::cerr << "Options, applied in order (defaults in parentheses):" << std::endl;
+    printServerConfigOptions(std::cerr);
+}
+
 int main(int argc, char* argv[]) {
-    // Default parameters
-    int port = 8888;
-    size_t threadPoolSize = 4;
-    
-    if (argc > 1) {
-        port = std::atoi(argv[1]);
-        if (port <= 0 || port > 65535) {
-            std::cerr << "Invalid port number" << std::endl;
-            std::cerr << "Usage: " << argv[0] << " [port] [thread_pool_size]" << std::endl;
-            std::cerr << "  port: 1-65535 (default: 8888)" << std::endl;
-            std::cerr << "  thread_pool_size: number of worker threads (default: 4)" << std::endl;
-            return 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
         }
     }
 
-    if (argc > 2) {
-        threadPoolSize = std::atoi(argv[2]);
-        if (threadPoolSize == 0) {
-            threadPoolSize = 1;
-        }
+    ServerConfig config;
+    if (!parseServerConfigArgs(argc, argv, config)) {
+        Logger::instance().shutdown();
+        printUsage(argv[0]);
+        return 1;
     }
 
-    std::cout << "Starting TCP Server..." << std::endl;
-    std::cout << "  Port: " << port << std::endl;
-    std::cout << "  Thread Pool Size: " << threadPoolSize << std::endl;
-    std::cout << "  Heartbeat Timeout: 10 seconds" << std::endl;
+    Logger::instance().setLevel(config.logLevel);
+    // Must precede the first use of the pool
+    BufferPool::setDefaultHugePages(config.hugePages);
+
+    const EventLoopConfig& loop = config.loop;
+    LOG_INFO << "Starting TCP Server...";
+    LOG_INFO << "  Port: " << loop.port;
+    LOG_INFO << "  Thread Pool Size: " << config.pool.threadCount;
+    LOG_INFO << "  Reactors: " << config.reactorCount;
+    LOG_INFO << "  Scheduler: "
+             << (config.pool.scheduler == SchedulerType::WORK_STEALING ? "stealing" : "queue");
+    LOG_INFO << "  I/O Backend: "
+             << (config.ioBackend == IoBackend::IO_URING ? "uring" : "epoll");
+    LOG_INFO << "  Huge Pages: " << (config.hugePages ? "on" : "off");
+    LOG_INFO << "  Heartbeat Timeout: " << config.heartbeatTimeoutSeconds << " seconds";
+    LOG_INFO << "  Socket: backlog=" << loop.listenBacklog
+             << " nodelay=" << (loop.tcpNoDelay ? "on" : "off")
+             << " rcvbuf=" << loop.recvBufferBytes << " sndbuf=" << loop.sendBufferBytes
+             << " defer_accept=" << loop.deferAcceptSeconds
+             << " busy_poll_us=" << loop.busyPollUs;
+    LOG_INFO << "  Loop: max_events=" << loop.maxEvents << " recv_chunk=" << loop.recvChunkBytes
+             << " poll_timeout_ms=" << loop.pollTimeoutMs;
 
     // Setup signal handlers
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
 
     // Create and start server
-    g_server = std::make_unique<Server>(port, 10, threadPoolSize);
-    
+    g_server.reset(new Server(config));
+
     if (!g_server->start()) {
-        std::cerr << "Failed to start server" << std::endl;
+        LOG_ERROR << "Failed to start server";
+        g_server.reset();
+        Logger::instance().shutdown();
         return 1;
     }
 
-    // Run server
+    // Local metrics endpoint, scrape with: nc -U $XDG_RUNTIME_DIR/tcp_server_<port>.sock
+    std::string adminPath = config.adminSocketPath.empty()
+        ? AdminServer::defaultPath(loop.port)
+        : config.adminSocketPath;
+    if (!adminPath.empty()) {
+        g_server->startAdminSocket(adminPath);
+    }
+
+    // Run server until a signal asks it to stop
     g_server->run();
 
+    // A second signal while stopping kills the process
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+
+    LOG_INFO << "Received signal, shutting down...";
+    g_server->stop();
+    g_server.reset();
+    Logger::instance().shutdown();
     return 0;
 }
@@ -0,0 +1,449 @@
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../include/Protocol.h"
+#include "../include/PacketBuffer.h"
+#include "../include/Logger.h"
+#include "../include/Session.h"
+#include "../include/SessionManager.h"
+#include "../include/HeartbeatManager.h"
+#include "../include/MessageDispatcher.h"
+#include "../include/Executor.h"
+
+using namespace tcp_server;
+
+// Microbenchmarks for the per-message hot paths. Every benchmark is
+// calibrated to run at least MIN_BATCH_MS per batch, then measured over
+// REPETITIONS batches; the median batch is reported as ns/op and
+// allocations/op (global operator new calls from any thread).
+//
+//   ./micro_bench              run everything
+//   ./micro_bench dispatch     only benchmarks whose name contains "dispatch"
+
+namespace {
+
+constexpr int MIN_BATCH_MS = 50;
+constexpr int REPETITIONS = 5;
+
+std::atomic<uint64_t> allocationCount(0);
+
+// Keep the compiler from discarding a computed value
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BatchResult {
+    int64_t elapsedNs;
+    uint64_t allocations;
+};
+
+const char* g_filter = nullptr;
+
+// fn(iterations) runs one batch of the operation
+template <typename Fn>
+void runBench(const std::string& name, Fn fn) {
+    if (g_filter && name.find(g_filter) == std::string::npos) {
+        return;
+    }
+
+    // Warm up and grow the batch until it is long enough to time
+    size_t iterations = 1;
+    while (true) {
+        int64_t start = nowNs();
+        fn(iterations);
+        int64_t elapsed = nowNs() - start;
+        if (elapsed >= MIN_BATCH_MS * 1000000LL || iterations >= (1ULL << 30)) {
+            break;
+        }
+        size_t scale = elapsed > 0 ?
+            static_cast<size_t>(MIN_BATCH_MS * 1000000LL * 1.2 / elapsed) + 1 : 100;
+        iterations *= std::min<size_t>(std::max<size_t>(scale, 2), 100);
+    }
+
+    std::vector<BatchResult> results;
+    for (int i = 0; i < REPETITIONS; ++i) {
+        uint64_t allocStart = allocationCount.load();
+        int64_t start = nowNs();
+        fn(iterations);
+        BatchResult result;
+        result.elapsedNs = nowNs() - start;
+        result.allocations = allocationCount.load() - allocStart;
+        results.push_back(result);
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const BatchResult& a, const BatchResult& b) {
+                  return a.elapsedNs < b.elapsedNs;
+              });
+    const BatchResult& median = results[REPETITIONS / 2];
+
+    printf("%-46s %12zu %12.1f %12.2f\n", name.c_str(), iterations,
+           static_cast<double>(median.elapsedNs) / iterations,
+           static_cast<double>(median.allocations) / iterations);
+    fflush(stdout);
+}
+
+// Wire bytes of one message with the given type and body size
+std::string encodeMessage(MessageType type, size_t bodySize) {
+    MessageHeader header;
+    header.type = static_cast<uint16_t>(type);
+    header.bodyLength = static_cast<uint32_t>(bodySize);
+    header.totalLength = static_cast<uint32_t>(sizeof(MessageHeader) + bodySize);
+
+    std::string wire(reinterpret_cast<const char*>(&header), sizeof(header));
+    wire.append(bodySize, 'x');
+    return wire;
+}
+
+// --- PacketBuffer ---------------------------------------------------------
+
+// How one message arrives from the socket
+enum class Fragmentation {
+    WHOLE,     // one append per message
+    BATCHED,   // 16 messages per append
+    SPLIT,     // header split in two, body in a third append
+    CHUNK64    // 64-byte appends
+};
+
+const char* fragmentationName(Fragmentation pattern) {
+    switch (pattern) {
+        case Fragmentation::WHOLE:   return "whole";
+        case Fragmentation::BATCHED: return "batched16";
+        case Fragmentation::SPLIT:   return "split3";
+        case Fragmentation::CHUNK64: return "chunk64";
+    }
+    return "?";
+}
+
+void benchPacketBuffer() {
+    const size_t bodySizes[] = {0, 64, 1024, 16384};
+    const Fragmentation patterns[] = {
+        Fragmentation::WHOLE, Fragmentation::BATCHED,
+        Fragmentation::SPLIT, Fragmentation::CHUNK64
+    };
+
+    for (Fragmentation pattern : patterns) {
+        for (size_t bodySize : bodySizes) {
+            const size_t batch = pattern == Fragmentation::BATCHED ? 16 : 1;
+            std::string wire;
+            for (size_t i = 0; i < batch; ++i) {
+                wire += encodeMessage(MessageType::DATA, bodySize);
+            }
+
+            std::string name = std::string("packet_buffer/") +
+                fragmentationName(pattern) + "/" + std::to_string(bodySize);
+
+            // One op is one message appended and extracted
+            runBench(name, [&](size_t iterations) {
+                PacketBuffer buffer;
+                Message message;
+                size_t done = 0;
+                while (done < iterations) {
+                    switch (pattern) {
+                        case Fragmentation::WHOLE:
+                        case Fragmentation::BATCHED:
+                            buffer.append(wire.data(), wire.size());
+                            break;
+                        case Fragmentation::SPLIT:
+                            buffer.append(wire.data(), 7);
+                            buffer.append(wire.data() + 7, sizeof(MessageHeader) - 7);
+                            buffer.append(wire.data() + sizeof(MessageHeader),
+                                          wire.size() - sizeof(MessageHeader));
+                            break;
+                        case Fragmentation::CHUNK64:
+                            for (size_t pos = 0; pos < wire.size(); pos += 64) {
+                                buffer.append(wire.data() + pos,
+                                              std::min<size_t>(64, wire.size() - pos));
+                            }
+                            break;
+                    }
+                    while (buffer.extractMessage(message)) {
+                        keep(message);
+                        ++done;
+                    }
+                }
+            });
+        }
+    }
+}
+
+// --- validateHeader ---------------------------------------------------------
+
+void benchValidateHeader() {
+    // Mix of valid and broken headers so the branches are not all predicted
+    std::vector<MessageHeader> headers(64);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        headers[i].type = static_cast<uint16_t>(MessageType::DATA);
+        headers[i].bodyLength = static_cast<uint32_t>(i * 16);
+        headers[i].totalLength = static_cast<uint32_t>(sizeof(MessageHeader) + i * 16);
+    }
+
+    runBench("validate_header/valid", [&](size_t iterations) {
+        size_t valid = 0;
+        for (size_t i = 0; i < iterations; ++i) {
+            valid += validateHeader(headers[i & 63]) == HeaderValidationResult::VALID;
+        }
+        keep(valid);
+    });
+
+    std::vector<MessageHeader> mixed = headers;
+    for (size_t i = 0; i < mixed.size(); i += 4) {
+        switch ((i / 4) % 4) {
+            case 0: mixed[i].magic = 0; break;
+            case 1: mixed[i].type = 0; break;
+            case 2: mixed[i].totalLength = 1; break;
+            case 3: mixed[i].totalLength += 1; break;
+        }
+    }
+
+    runBench("validate_header/mixed25", [&](size_t iterations) {
+        size_t valid = 0;
+        for (size_t i = 0; i < iterations; ++i) {
+            valid += validateHeader(mixed[i & 63]) == HeaderValidationResult::VALID;
+        }
+        keep(valid);
+    });
+}
+
+// --- MessageDispatcher ------------------------------------------------------
+
+// Message whose body lives in a pooled block, like one from PacketBuffer
+Message makeMessage(MessageType type, const char* body, size_t bodySize) {
+    MessageHeader header;
+    header.type = static_cast<uint16_t>(type);
+    header.bodyLength = static_cast<uint32_t>(bodySize);
+    header.totalLength = static_cast<uint32_t>(sizeof(MessageHeader) + bodySize);
+
+    BufferRef block = BufferPool::defaultPool().acquire(bodySize + 1);
+    if (bodySize > 0) {
+        std::memcpy(block->data(), body, bodySize);
+    }
+    return Message(header, block, bodySize > 0 ? block->data() : nullptr);
+}
+
+void drainSocket(int fd) {
+    char buf[65536];
+    while (::read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+void benchDispatch() {
+    // Replies go over a socketpair whose peer end is drained as we go,
+    // so the numbers include the reply's send syscall
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        return;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    SessionManagerPtr sessionMgr = std::make_shared<SessionManager>();
+    HeartbeatManagerPtr heartbeatMgr = std::make_shared<HeartbeatManager>(10);
+    MessageDispatcher dispatcher(sessionMgr, heartbeatMgr);
+
+    SessionPtr session = Session::create(fds[0]);
+    sessionMgr->addSession(session);
+
+    LoginRequest req;
+    std::memset(&req, 0, sizeof(req));
+    std::strncpy(req.username, "bench", sizeof(req.username) - 1);
+    std::strncpy(req.password, "bench", sizeof(req.password) - 1);
+
+    std::string payload(64, 'x');
+    struct Case {
+        const char* name;
+        Message message;
+    };
+    Case cases[] = {
+        {"dispatch/login", makeMessage(MessageType::LOGIN_REQUEST,
+                                       reinterpret_cast<const char*>(&req), sizeof(req))},
+        {"dispatch/heartbeat", makeMessage(MessageType::HEARTBEAT, nullptr, 0)},
+        {"dispatch/data64", makeMessage(MessageType::DATA, payload.data(), payload.size())},
+        {"dispatch/unknown", makeMessage(MessageType::BROADCAST, nullptr, 0)},
+    };
+
+    // Log in once so heartbeat and data take their authenticated paths
+    dispatcher.dispatch(session, cases[0].message);
+    drainSocket(fds[1]);
+
+    for (const Case& c : cases) {
+        runBench(c.name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                dispatcher.dispatch(session, c.message);
+                if ((i & 63) == 63) {
+                    drainSocket(fds[1]);
+                }
+            }
+            drainSocket(fds[1]);
+        });
+    }
+
+    session->markClosed();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// --- Executors --------------------------------------------------------------
+
+void benchExecutors() {
+    const SchedulerType types[] = {SchedulerType::GLOBAL_QUEUE, SchedulerType::WORK_STEALING};
+
+    for (SchedulerType type : types) {
+        const char* typeName = type == SchedulerType::GLOBAL_QUEUE ? "queue" : "stealing";
+        ExecutorPtr executor = createExecutor(type, 4);
+        std::atomic<size_t> done(0);
+
+        // Submit, wait until the task ran, repeat
+        runBench(std::string("executor/") + typeName + "/round_trip", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                size_t target = done.load() + 1;
+                executor->submit([&done]() { done.fetch_add(1); });
+                while (done.load() < target) {
+                }
+            }
+        });
+
+        // Submit a burst, wait for all of it
+        runBench(std::string("executor/") + typeName + "/burst1024", [&](size_t iterations) {
+            size_t submitted = 0;
+            while (submitted < iterations) {
+                size_t burst = std::min<size_t>(1024, iterations - submitted);
+                size_t target = done.load() + burst;
+                for (size_t i = 0; i < burst; ++i) {
+                    executor->submit([&done]() { done.fetch_add(1); });
+                }
+                while (done.load() < target) {
+                }
+                submitted += burst;
+            }
+        });
+    }
+}
+
+// --- SessionManager ---------------------------------------------------------
+
+void benchSessionManager() {
+    const size_t sizes[] = {10000, 100000, 1000000};
+
+    for (size_t count : sizes) {
+        std::string suffix = std::to_string(count / 1000) + "k";
+        std::string fdName = "session_manager/get_by_fd/" + suffix;
+        std::string userName = "session_manager/get_by_username/" + suffix;
+        if (g_filter && fdName.find(g_filter) == std::string::npos &&
+            userName.find(g_filter) == std::string::npos) {
+            continue;
+        }
+
+        // Sessions are never written to, the fds are just keys
+        SessionManager manager;
+        std::vector<std::string> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            SessionPtr session = Session::create(static_cast<int>(i + 1000));
+            manager.addSession(session);
+            names.push_back("user" + std::to_string(i));
+            manager.bindUsername(session, names.back());
+        }
+
+        // Random but repeatable probe order
+        std::vector<uint32_t> probes(4096);
+        uint64_t state = 0x9e3779b97f4a7c15ULL;
+        for (auto& probe : probes) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            probe = static_cast<uint32_t>(state % count);
+        }
+
+        runBench(fdName, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                SessionPtr session = manager.getSession(static_cast<int>(probes[i & 4095] + 1000));
+                keep(session);
+            }
+        });
+
+        runBench(userName, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                SessionPtr session = manager.getSessionByUsername(names[probes[i & 4095]]);
+                keep(session);
+            }
+        });
+    }
+}
+
+} // namespace
+
+// Count every allocation in the process
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        g_filter = argv[1];
+    }
+
+    // Benchmark the code paths, not the log output
+    Logger::instance().setLevel(LogLevel::OFF);
+
+    printf("%-46s %12s %12s %12s\n", "benchmark", "ops/batch", "ns/op", "allocs/op");
+
+    benchPacketBuffer();
+    benchValidateHeader();
+    benchDispatch();
+    benchExecutors();
+    benchSessionManager();
+
+    return 0;
+}
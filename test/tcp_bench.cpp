@@ -0,0 +1,525 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/Protocol.h"
+#include "../include/Metrics.h"
+
+using namespace tcp_server;
+
+// Load generator: many connections spread over a few epoll threads, each
+// logged in and kept busy with DATA/HEARTBEAT requests. The server answers
+// each type in order, but heartbeat replies are sent from the reactor and
+// on the urgent output lane, so they may overtake earlier DATA echoes.
+// Responses are therefore matched against the oldest outstanding request
+// of the same type.
+
+// Failures printed individually, the rest are only counted
+constexpr size_t MAX_REPORTED_FAILURES = 10;
+
+struct BenchOptions {
+    std::string host = "127.0.0.1";
+    int port = 8888;
+    size_t connections = 1000;
+    size_t threads = 4;
+    size_t pipeline = 1;        // outstanding requests per connection
+    size_t payload = 64;        // DATA body bytes
+    double heartbeatRatio = 0;  // share of requests sent as HEARTBEAT
+    int warmupSeconds = 1;
+    int durationSeconds = 10;
+    std::string userPrefix = "bench";
+};
+
+struct BenchStats {
+    std::atomic<size_t> connected{0};
+    std::atomic<size_t> loggedIn{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> bytesOut{0};
+    std::atomic<uint64_t> bytesIn{0};
+    Histogram latency;  // round trip in ns
+};
+
+enum class ConnState {
+    LOGGING_IN,
+    RUNNING,
+    CLOSED
+};
+
+struct Connection {
+    int fd = -1;
+    ConnState state = ConnState::LOGGING_IN;
+    std::vector<char> input;
+    std::string output;
+    size_t outputPos = 0;
+    bool writeArmed = false;
+    // Send timestamps per request type, oldest first
+    std::deque<int64_t> dataInflight;
+    std::deque<int64_t> heartbeatInflight;
+
+    std::deque<int64_t>* inflightFor(uint16_t type) {
+        if (type == static_cast<uint16_t>(MessageType::DATA)) {
+            return &dataInflight;
+        }
+        if (type == static_cast<uint16_t>(MessageType::HEARTBEAT)) {
+            return &heartbeatInflight;
+        }
+        return nullptr;
+    }
+};
+
+class BenchWorker {
+public:
+    BenchWorker(const BenchOptions& options, BenchStats& stats, size_t firstUser,
+                size_t count, uint64_t seed)
+        : options_(options)
+        , stats_(stats)
+        , firstUser_(firstUser)
+        , count_(count)
+        , rng_(seed | 1)
+        , epollFd_(-1) {
+        payload_.assign(options_.payload, 'x');
+    }
+
+    ~BenchWorker() {
+        for (auto& conn : conns_) {
+            if (conn->fd >= 0) {
+                close(conn->fd);
+            }
+        }
+        if (epollFd_ >= 0) {
+            close(epollFd_);
+        }
+    }
+
+    void run(const std::atomic<bool>& measuring, const std::atomic<bool>& stopping) {
+        measuring_ = &measuring;
+
+        epollFd_ = epoll_create1(0);
+        if (epollFd_ < 0) {
+            std::cerr << "epoll_create1 failed: " << strerror(errno) << std::endl;
+            stats_.failed += count_;
+            return;
+        }
+
+        for (size_t i = 0; i < count_; ++i) {
+            openConnection(firstUser_ + i);
+        }
+
+        struct epoll_event events[256];
+        while (!stopping.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epollFd_, events, 256, 100);
+            for (int i = 0; i < n; ++i) {
+                Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+                if (conn->state == ConnState::CLOSED) {
+                    continue;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    fail(conn, "connection reset");
+                    continue;
+                }
+                if (events[i].events & EPOLLIN) {
+                    readInput(conn);
+                }
+                if (conn->state != ConnState::CLOSED && (events[i].events & EPOLLOUT)) {
+                    flushOutput(conn);
+                }
+            }
+        }
+    }
+
+private:
+    void openConnection(size_t userIndex) {
+        std::unique_ptr<Connection> conn(new Connection());
+
+        conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (conn->fd < 0) {
+            reportFailure("socket", strerror(errno));
+            return;
+        }
+
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options_.port);
+        inet_pton(AF_INET, options_.host.c_str(), &addr.sin_addr);
+
+        if (::connect(conn->fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            reportFailure("connect", strerror(errno));
+            close(conn->fd);
+            return;
+        }
+
+        int one = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL, 0) | O_NONBLOCK);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn.get();
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, conn->fd, &ev);
+        stats_.connected++;
+
+        LoginRequest req;
+        std::memset(&req, 0, sizeof(req));
+        std::string username = options_.userPrefix + std::to_string(userIndex);
+        std::strncpy(req.username, username.c_str(), sizeof(req.username) - 1);
+        std::strncpy(req.password, "bench", sizeof(req.password) - 1);
+
+        MessageHeader header;
+        header.type = static_cast<uint16_t>(MessageType::LOGIN_REQUEST);
+        header.bodyLength = sizeof(LoginRequest);
+        header.totalLength = sizeof(MessageHeader) + sizeof(LoginRequest);
+
+        Connection* raw = conn.get();
+        conns_.push_back(std::move(conn));
+        queueMessage(raw, header, reinterpret_cast<const char*>(&req));
+        flushOutput(raw);
+    }
+
+    void sendRequest(Connection* conn) {
+        MessageHeader header;
+        const char* body = nullptr;
+
+        if (options_.heartbeatRatio > 0 && nextRandom() < options_.heartbeatRatio) {
+            header.type = static_cast<uint16_t>(MessageType::HEARTBEAT);
+        } else {
+            header.type = static_cast<uint16_t>(MessageType::DATA);
+            header.bodyLength = static_cast<uint32_t>(payload_.size());
+            header.totalLength = sizeof(MessageHeader) + payload_.size();
+            body = payload_.data();
+        }
+
+        conn->inflightFor(header.type)->push_back(nowNs());
+        queueMessage(conn, header, body);
+    }
+
+    void queueMessage(Connection* conn, const MessageHeader& header, const char* body) {
+        conn->output.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (body && header.bodyLength > 0) {
+            conn->output.append(body, header.bodyLength);
+        }
+    }
+
+    void flushOutput(Connection* conn) {
+        while (conn->outputPos < conn->output.size()) {
+            ssize_t n = ::send(conn->fd, conn->output.data() + conn->outputPos,
+                               conn->output.size() - conn->outputPos, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                fail(conn, strerror(errno));
+                return;
+            }
+            conn->outputPos += n;
+            stats_.bytesOut.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        bool pending = conn->outputPos < conn->output.size();
+        if (!pending) {
+            conn->output.clear();
+            conn->outputPos = 0;
+        }
+
+        if (pending != conn->writeArmed) {
+            struct epoll_event ev;
+            ev.events = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+            ev.data.ptr = conn;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn->fd, &ev);
+            conn->writeArmed = pending;
+        }
+    }
+
+    void readInput(Connection* conn) {
+        char buf[16384];
+        while (true) {
+            ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                fail(conn, strerror(errno));
+                return;
+            }
+            if (n == 0) {
+                fail(conn, "closed by server");
+                return;
+            }
+            conn->input.insert(conn->input.end(), buf, buf + n);
+            stats_.bytesIn.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        size_t offset = 0;
+        while (conn->input.size() - offset >= sizeof(MessageHeader)) {
+            MessageHeader header;
+            std::memcpy(&header, conn->input.data() + offset, sizeof(header));
+            if (validateHeader(header) != HeaderValidationResult::VALID) {
+                fail(conn, "invalid response header");
+                return;
+            }
+            if (conn->input.size() - offset < header.totalLength) {
+                break;
+            }
+            handleResponse(conn, header, conn->input.data() + offset + sizeof(header));
+            if (conn->state == ConnState::CLOSED) {
+                return;
+            }
+            offset += header.totalLength;
+        }
+        conn->input.erase(conn->input.begin(), conn->input.begin() + offset);
+
+        flushOutput(conn);
+    }
+
+    void handleResponse(Connection* conn, const MessageHeader& header, const char* body) {
+        if (conn->state == ConnState::LOGGING_IN) {
+            LoginResponse resp;
+            if (header.type != static_cast<uint16_t>(MessageType::LOGIN_RESPONSE) ||
+                header.bodyLength < sizeof(resp)) {
+                fail(conn, "unexpected login response");
+                return;
+            }
+            std::memcpy(&resp, body, sizeof(resp));
+            if (resp.success != 1) {
+                fail(conn, resp.message);
+                return;
+            }
+
+            conn->state = ConnState::RUNNING;
+            stats_.loggedIn++;
+            for (size_t i = 0; i < options_.pipeline; ++i) {
+                sendRequest(conn);
+            }
+            return;
+        }
+
+        std::deque<int64_t>* inflight = conn->inflightFor(header.type);
+        if (!inflight || inflight->empty()) {
+            fail(conn, "unsolicited response");
+            return;
+        }
+
+        int64_t sentAt = inflight->front();
+        inflight->pop_front();
+        if (measuring_->load(std::memory_order_relaxed)) {
+            stats_.latency.record(static_cast<uint64_t>(nowNs() - sentAt));
+        }
+
+        sendRequest(conn);
+    }
+
+    void fail(Connection* conn, const char* reason) {
+        if (conn->state == ConnState::CLOSED) {
+            return;
+        }
+        reportFailure("connection", reason);
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        conn->fd = -1;
+        conn->state = ConnState::CLOSED;
+    }
+
+    void reportFailure(const char* what, const char* reason) {
+        // Print the first few, a connection storm would flood the terminal
+        if (stats_.failed.fetch_add(1) < MAX_REPORTED_FAILURES) {
+            std::cerr << what << " failed: " << reason << std::endl;
+        }
+    }
+
+    // Uniform in [0, 1)
+    double nextRandom() {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        return static_cast<double>(rng_ >> 11) / static_cast<double>(1ULL << 53);
+    }
+
+    static int64_t nowNs() { return metricsNowNs(); }
+
+    const BenchOptions& options_;
+    BenchStats& stats_;
+    size_t firstUser_;
+    size_t count_;
+    uint64_t rng_;
+    int epollFd_;
+    std::string payload_;
+    const std::atomic<bool>* measuring_ = nullptr;
+    std::vector<std::unique_ptr<Connection>> conns_;
+};
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --host ADDR          server address (default 127.0.0.1)\n"
+              << "  --port N             server port (default 8888)\n"
+              << "  --connections N      total connections (default 1000)\n"
+              << "  --threads N          client threads (default 4)\n"
+              << "  --pipeline N         outstanding requests per connection (default 1)\n"
+              << "  --payload N          DATA body size in bytes (default 64)\n"
+              << "  --heartbeat-ratio F  share of requests sent as HEARTBEAT, 0..1 (default 0)\n"
+              << "  --warmup S           seconds before measuring starts (default 1)\n"
+              << "  --duration S         measured seconds (default 10)\n"
+              << "  --user-prefix NAME   login name prefix, must be unique per run (default bench)\n";
+}
+
+static bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    static const struct option longOptions[] = {
+        {"host", required_argument, nullptr, 'h'},
+        {"port", required_argument, nullptr, 'p'},
+        {"connections", required_argument, nullptr, 'c'},
+        {"threads", required_argument, nullptr, 't'},
+        {"pipeline", required_argument, nullptr, 'd'},
+        {"payload", required_argument, nullptr, 's'},
+        {"heartbeat-ratio", required_argument, nullptr, 'r'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"duration", required_argument, nullptr, 'T'},
+        {"user-prefix", required_argument, nullptr, 'u'},
+        {"help", no_argument, nullptr, '?'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'h': options.host = optarg; break;
+            case 'p': options.port = std::atoi(optarg); break;
+            case 'c': options.connections = std::strtoul(optarg, nullptr, 10); break;
+            case 't': options.threads = std::strtoul(optarg, nullptr, 10); break;
+            case 'd': options.pipeline = std::strtoul(optarg, nullptr, 10); break;
+            case 's': options.payload = std::strtoul(optarg, nullptr, 10); break;
+            case 'r': options.heartbeatRatio = std::atof(optarg); break;
+            case 'w': options.warmupSeconds = std::atoi(optarg); break;
+            case 'T': options.durationSeconds = std::atoi(optarg); break;
+            case 'u': options.userPrefix = optarg; break;
+            default: return false;
+        }
+    }
+
+    if (options.port <= 0 || options.port > 65535 || options.connections == 0 ||
+        options.threads == 0 || options.pipeline == 0 || options.durationSeconds <= 0 ||
+        options.payload > MAX_BODY_SIZE || options.heartbeatRatio < 0 ||
+        options.heartbeatRatio > 1) {
+        return false;
+    }
+    if (options.threads > options.connections) {
+        options.threads = options.connections;
+    }
+    return true;
+}
+
+// Thousands of sockets need more than the usual soft limit of 1024
+static void raiseFileLimit(size_t connections) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < connections + 64) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    raiseFileLimit(options.connections);
+
+    std::cout << "tcp_bench: " << options.connections << " connections, "
+              << options.threads << " threads, pipeline " << options.pipeline
+              << ", payload " << options.payload << " bytes, heartbeat ratio "
+              << options.heartbeatRatio << std::endl;
+
+    BenchStats stats;
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> stopping(false);
+
+    std::vector<std::unique_ptr<BenchWorker>> workers;
+    std::vector<std::thread> threads;
+    size_t firstUser = 0;
+    for (size_t i = 0; i < options.threads; ++i) {
+        size_t count = options.connections / options.threads +
+                       (i < options.connections % options.threads ? 1 : 0);
+        workers.emplace_back(new BenchWorker(options, stats, firstUser, count, i + 1));
+        firstUser += count;
+    }
+    for (auto& worker : workers) {
+        BenchWorker* raw = worker.get();
+        threads.emplace_back([raw, &measuring, &stopping]() {
+            raw->run(measuring, stopping);
+        });
+    }
+
+    // Wait for every connection to log in or fail
+    auto loginDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (stats.loggedIn + stats.failed < options.connections &&
+           std::chrono::steady_clock::now() < loginDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::cout << "logged in: " << stats.loggedIn << ", failed: " << stats.failed << std::endl;
+    if (stats.loggedIn == 0) {
+        stopping = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return 2;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.warmupSeconds));
+
+    uint64_t bytesOutStart = stats.bytesOut;
+    uint64_t bytesInStart = stats.bytesIn;
+    int64_t startNs = metricsNowNs();
+    measuring = true;
+    std::this_thread::sleep_for(std::chrono::seconds(options.durationSeconds));
+    measuring = false;
+    int64_t elapsedNs = metricsNowNs() - startNs;
+    uint64_t bytesOut = stats.bytesOut - bytesOutStart;
+    uint64_t bytesIn = stats.bytesIn - bytesInStart;
+
+    stopping = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    workers.clear();
+
+    double seconds = static_cast<double>(elapsedNs) / 1e9;
+    HistogramSummary latency = stats.latency.summarize();
+
+    printf("responses:   %llu in %.2f s\n",
+           static_cast<unsigned long long>(latency.count), seconds);
+    printf("throughput:  %.0f msg/s, out %.2f MB/s, in %.2f MB/s\n",
+           static_cast<double>(latency.count) / seconds,
+           static_cast<double>(bytesOut) / seconds / 1e6,
+           static_cast<double>(bytesIn) / seconds / 1e6);
+    printf("latency us:  mean %.1f  p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           latency.mean / 1e3, latency.p50 / 1e3, latency.p99 / 1e3,
+           latency.p999 / 1e3, latency.max / 1e3);
+    printf("failed connections: %zu\n", stats.failed.load());
+
+    return stats.failed > 0 ? 2 : 0;
+}